@@ -0,0 +1,146 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "config.h"
+#include "storage.h"
+
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* released regions, kept mapped (and touched) for the next problems of a batch */
+typedef struct {
+    char *base;
+    size_t size;
+    int huge;
+} arena_region;
+
+static arena_region cache[ARENA_CACHE];
+
+static size_t round_up(size_t x, size_t align) {
+    return (x + align - 1) / align * align;
+}
+
+/// @brief room taken in an arena by an array, with the padding of its alignment
+size_t arena_bytes(size_t bytes) {
+    return round_up(bytes, ARENA_ALIGN) + ARENA_ALIGN;
+}
+
+/// @brief maps a region, with huge pages if asked by ARENA_HUGE_PAGES (file-backed with LARGE_GRID)
+/// @param size asked size, rounded up to a multiple of the huge page size if they are used
+/// @param huge kind of pages that were obtained
+/// @return the region, NULL if it could not be mapped
+static char *map_region(size_t *size, int *huge) {
+    #if LARGE_GRID
+    *huge = 0;
+    return (char*)storage_alloc(*size, "arena");
+    #else
+    *huge = ARENA_HUGE_PAGES;
+    if (*huge == 0) {
+        void *base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return base == MAP_FAILED ? NULL : (char*)base;
+    }
+    *size = round_up(*size, HUGE_PAGE_SIZE);
+    if (*huge == 2) {
+        void *base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) return (char*)base;
+        printf("no explicit huge pages available (see /proc/sys/vm/nr_hugepages), transparent huge pages are used\n");
+        *huge = 1;
+    }
+    /* the kernel only gives transparent huge pages to aligned 2M ranges : one more is mapped and the ends are cut */
+    char *raw = (char*)mmap(NULL, *size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (char*)MAP_FAILED) return NULL;
+    char *base = (char*)round_up((size_t)raw, HUGE_PAGE_SIZE);
+    if (base > raw) munmap(raw, base - raw);
+    munmap(base + *size, raw + HUGE_PAGE_SIZE - base);
+    madvise(base, *size, MADV_HUGEPAGE);
+    return base;
+    #endif
+}
+
+static void unmap_region(char *base, size_t size) {
+    #if LARGE_GRID
+    storage_free(base);
+    #else
+    munmap(base, size);
+    #endif
+}
+
+/// @brief next array of the arena, aligned on ARENA_ALIGN bytes
+/// @return NULL if the arena is full
+static void *arena_alloc(arena *self, size_t bytes) {
+    size_t offset = round_up(self->used, ARENA_ALIGN);
+    if (offset + bytes > self->size) {
+        printf("\n ERROR : the arena of %zu bytes is full (%zu more bytes asked)\n\n", self->size, bytes);
+        return NULL;
+    }
+    self->used = offset + bytes;
+    return self->base + offset;
+}
+
+/// @brief releases all the arrays of the arena at once, the region goes to the cache
+/// (in place of the smallest cached one if the cache is full)
+static void release_arena(arena *self) {
+    if (self->base == NULL) return;
+    int slot = -1;
+    for (int k = 0; k < ARENA_CACHE; k++) {
+        if (cache[k].base == NULL) { slot = k; break; }
+        if (slot == -1 || cache[k].size < cache[slot].size) slot = k;
+    }
+    if (slot != -1 && (cache[slot].base == NULL || cache[slot].size < self->size)) {
+        if (cache[slot].base != NULL) unmap_region(cache[slot].base, cache[slot].size);
+        cache[slot].base = self->base;
+        cache[slot].size = self->size;
+        cache[slot].huge = self->huge;
+    } else {
+        unmap_region(self->base, self->size);
+    }
+    self->base = NULL;
+    self->size = self->used = 0;
+}
+
+/// @brief Initializes an arena of at least size bytes : the smallest released region that is large enough
+/// is reused, otherwise a new one is mapped and first touched by the calling thread, so that its pages
+/// are placed on the NUMA node of the process that will use them (one process per node with USE_MPI)
+/// @param size sum of arena_bytes() of the arrays that will be allocated
+/// @return integer for error handling
+int init_arena(arena *self, size_t size) {
+    self->used = 0;
+    self->alloc = arena_alloc;
+    self->close = release_arena;
+
+    int best = -1;
+    for (int k = 0; k < ARENA_CACHE; k++) {
+        if (cache[k].base == NULL || cache[k].size < size) continue;
+        if (best == -1 || cache[k].size < cache[best].size) best = k;
+    }
+    if (best != -1) {
+        self->base = cache[best].base;
+        self->size = cache[best].size;
+        self->huge = cache[best].huge;
+        self->reused = 1;
+        cache[best].base = NULL;
+        return EXIT_SUCCESS;
+    }
+
+    self->size = size;
+    self->base = map_region(&self->size, &self->huge);
+    self->reused = 0;
+    if (self->base == NULL) {
+        printf("\n ERROR : cannot map an arena of %zu bytes\n\n", size);
+        return EXIT_FAILURE;
+    }
+    #if !LARGE_GRID
+    memset(self->base, 0, self->size); // first touch
+    #endif
+    return EXIT_SUCCESS;
+}
+
+/// @brief unmaps the released regions kept for reuse
+void arena_trim(void) {
+    for (int k = 0; k < ARENA_CACHE; k++) {
+        if (cache[k].base != NULL) unmap_region(cache[k].base, cache[k].size);
+        cache[k].base = NULL;
+    }
+}
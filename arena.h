@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 64 // alignment of every array (cache line, widest simd load)
+
+/* one region holding all the arrays of a problem, they are released together by close,
+   the region itself is kept for the next arena that fits in it */
+typedef struct sArena arena;
+struct sArena {
+    char *base;
+    size_t size, used;
+    int huge; // pages of the region : 0 normal, 1 transparent huge pages, 2 explicit huge pages
+    int reused; // 1 if the region comes from a released arena (its pages are already touched)
+    void *(*alloc)(arena*, size_t);
+    void (*close)(arena*);
+};
+
+int init_arena(arena *self, size_t size);
+
+size_t arena_bytes(size_t bytes);
+
+void arena_trim(void);
+
+#endif // !ARENA_H
@@ -0,0 +1,173 @@
+#include "checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+
+#define CHECKPOINT_MAGIC "MEMBCHK"
+#define CHECKPOINT_VERSION 3
+
+/* integrator of the heat loop, stored to refuse a restart with another method */
+#if RKC_INTEGRATOR
+#define HEAT_INTEGRATOR 1
+#elif IMPLICIT_EULER
+#define HEAT_INTEGRATOR 2
+#else
+#define HEAT_INTEGRATOR 0
+#endif
+
+/// @brief FNV-1a hash of the header of a checkpoint (its checksum field taken as 0) and of its vectors
+static unsigned long long checksum(const checkpoint_state *state, const double *v, size_t len) {
+    checkpoint_state hd = *state;
+    hd.checksum = 0;
+    unsigned long long h = 14695981039346656037ULL;
+    const unsigned char *c = (const unsigned char*)&hd;
+    for (size_t k = 0; k < sizeof(checkpoint_state); k++) {
+        h ^= c[k];
+        h *= 1099511628211ULL;
+    }
+    c = (const unsigned char*)v;
+    for (size_t k = 0; k < len * sizeof(double); k++) {
+        h ^= c[k];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/// @brief body of the writer thread : the file is written next to the previous checkpoint,
+/// then renamed over it so that a crash during the write keeps the previous one
+static void *write_file(void *arg) {
+    checkpoint *s = (checkpoint*)arg;
+    int n = s->p->n;
+    char tmp[sizeof(s->path) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", s->path);
+
+    s->snapshot.checksum = checksum(&s->snapshot, s->buf, 2 * (size_t)n);
+    FILE *f = fopen(tmp, "wb");
+    int ok = f != NULL
+          && fwrite(&s->snapshot, sizeof(checkpoint_state), 1, f) == 1
+          && fwrite(s->buf, sizeof(double), 2 * (size_t)n, f) == 2 * (size_t)n;
+    if (f != NULL && fclose(f)) ok = 0;
+    if (ok && rename(tmp, s->path)) ok = 0;
+    s->status = ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    return NULL;
+}
+
+/// @brief waits for the write in progress
+/// @return result of the last write
+int checkpoint_wait(checkpoint *s) {
+    if (s->pending) {
+        pthread_join(s->thread, NULL);
+        s->pending = 0;
+        if (s->status) printf("\n ERROR : the checkpoint %s could not be written\n\n", s->path);
+    }
+    return s->status;
+}
+
+/// @brief starts writing a checkpoint in the background : the state and the vectors are copied once the previous
+/// write is finished and a thread writes them, the caller only waits if the previous write is not finished
+/// @param state state of the heat loop, made from s->state so that it holds the geometry
+/// @param uk temperature field
+/// @param last_frame field of the last emitted frame (heat monitor)
+/// @return integer for error handling
+int checkpoint_write(checkpoint *s, checkpoint_state state, double *uk, double *last_frame) {
+    checkpoint_wait(s);
+    int n = s->p->n;
+    s->snapshot = state;
+    memcpy(s->buf, uk, n * sizeof(double));
+    memcpy(s->buf + n, last_frame, n * sizeof(double));
+    if (pthread_create(&s->thread, NULL, write_file, s)) {
+        write_file(s); // no thread available, written synchronously
+        return s->status;
+    }
+    s->pending = 1;
+    return EXIT_SUCCESS;
+}
+
+/// @brief reads the checkpoint file into s->state and checks that it was written for the same problem
+/// @param uk temperature field to restore, NULL to only read and check the checkpoint
+/// @param last_frame field of the last emitted frame to restore, NULL to only read and check the checkpoint
+/// @return integer for error handling
+int checkpoint_read(checkpoint *s, double *uk, double *last_frame) {
+    checkpoint_state ref = s->state;
+    FILE *f = fopen(s->path, "rb");
+    if (f == NULL) {
+        printf("\n ERROR : cannot open the checkpoint %s\n\n", s->path);
+        return EXIT_FAILURE;
+    }
+    int n = s->p->n;
+    int ok = fread(&s->state, sizeof(checkpoint_state), 1, f) == 1;
+    int vectors = ok && fread(s->buf, sizeof(double), 2 * (size_t)n, f) == 2 * (size_t)n;
+    fclose(f);
+    if (!ok || memcmp(s->state.magic, ref.magic, sizeof(ref.magic)) || s->state.version != ref.version) {
+        printf("\n ERROR : %s is not a checkpoint of this version of the program\n\n", s->path);
+        s->state = ref;
+        return EXIT_FAILURE;
+    }
+    checkpoint_state *c = &s->state;
+    if (c->m != ref.m || c->n != ref.n || c->nx != ref.nx || c->ny != ref.ny || c->nnz != ref.nnz
+        || c->shape.x != ref.shape.x || c->shape.y != ref.shape.y || memcmp(&c->hole, &ref.hole, sizeof(Rectangle))) {
+        printf("\n ERROR : the checkpoint was written for another grid (m = %d, n = %d)\n\n", c->m, c->n);
+        s->state = ref;
+        return EXIT_FAILURE;
+    }
+    if (c->stencil != ref.stencil || c->integrator != ref.integrator || c->diffusivity != ref.diffusivity) {
+        printf("\n ERROR : the checkpoint was written with another stencil, integrator or diffusivity\n\n");
+        s->state = ref;
+        return EXIT_FAILURE;
+    }
+    /* the geometry above is only used to refuse the file, the whole of it is checked here */
+    if (!vectors || checksum(&s->state, s->buf, 2 * (size_t)n) != s->state.checksum) {
+        printf("\n ERROR : the checkpoint %s is corrupted\n\n", s->path);
+        s->state = ref;
+        return EXIT_FAILURE;
+    }
+    if (uk == NULL) return EXIT_SUCCESS;
+    memcpy(uk, s->buf, n * sizeof(double));
+    memcpy(last_frame, s->buf + n, n * sizeof(double));
+    return EXIT_SUCCESS;
+}
+
+/// @brief waits for the last write and frees the copy of the vectors
+void close_checkpoint(checkpoint *s) {
+    checkpoint_wait(s);
+    free(s->buf);
+}
+
+/// @brief Initializes the checkpoints of the heat loop
+/// @param self the yet uninitialized object
+/// @param path checkpoint file
+/// @param p the problem, its geometry is written in every checkpoint and checked on restart
+/// @return integer for error handling
+int init_checkpoint(checkpoint *self, const char *path, problem *p) {
+    snprintf(self->path, sizeof(self->path), "%s", path);
+    self->p = p;
+    self->pending = 0;
+    self->status = EXIT_SUCCESS;
+    self->buf = (double*)malloc(2 * (size_t)p->n * sizeof(double));
+    if (self->buf == NULL) {
+        printf("\n ERROR : not enough memory for the checkpoints\n\n");
+        return EXIT_FAILURE;
+    }
+
+    checkpoint_state *c = &self->state;
+    memset(c, 0, sizeof(checkpoint_state));
+    memcpy(c->magic, CHECKPOINT_MAGIC, sizeof(c->magic));
+    c->version = CHECKPOINT_VERSION;
+    c->m = p->m;
+    c->n = p->n;
+    c->nx = p->nx;
+    c->ny = p->ny;
+    c->shape = p->m_s;
+    c->hole = p->i_s;
+    c->nnz = p->ia[p->n];
+    c->stencil = STENCIL_9PT ? 9 : 5;
+    c->integrator = HEAT_INTEGRATOR;
+    c->diffusivity = DIFFUSIVITY;
+
+    self->write = checkpoint_write;
+    self->wait = checkpoint_wait;
+    self->read = checkpoint_read;
+    self->close = close_checkpoint;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <pthread.h>
+#include "prob.h"
+
+/* header of a checkpoint file, followed by the temperature field and the last emitted frame (n doubles each) */
+typedef struct {
+    char magic[8];
+    int version;
+    /* geometry and method, checked against the current program on restart */
+    int m, n, nx, ny;
+    pos2d shape;
+    Rectangle hole; // grid indices (i_s), the hole can be moved by the optimizer
+    int pad0; // explicit padding, zero : the whole header goes through the checksum and copies keep named fields only
+    long long nnz;
+    int stencil, integrator;
+    double diffusivity;
+    /* state of the heat loop */
+    double lambda_max; // the dt_max bound does not have to be solved again
+    double t;
+    double dt; // step proposed for the next RKC step (euler : fixed step)
+    int frame; // next iteration of the frame loop
+    int matvecs, steps, rejected, max_stages; // counters of the integrator
+    int frames, skipped; // counters of the heat monitor
+    int pad1; // explicit padding, zero
+    double rate; // last rms of du/dt
+    double step_time;
+    unsigned long long checksum; // of this header (with checksum = 0) and of the two vectors
+} checkpoint_state;
+
+typedef struct sCheckpoint checkpoint;
+struct sCheckpoint {
+    char path[256];
+    problem *p;
+    checkpoint_state state; // geometry set by init_checkpoint, the template of the states given to write()
+    checkpoint_state snapshot; // copy of the state being written, only read by the writer thread
+    double *buf; // copy of the vectors being written, the heat loop goes on meanwhile
+    pthread_t thread;
+    int pending; // a write is in progress
+    int status; // result of the last finished write
+    int (*write)(checkpoint*, checkpoint_state, double*, double*);
+    int (*wait)(checkpoint*);
+    int (*read)(checkpoint*, double*, double*);
+    void (*close)(checkpoint*);
+};
+
+int init_checkpoint(checkpoint *self, const char *path, problem *p);
+
+#endif // !CHECKPOINT_H
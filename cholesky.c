@@ -0,0 +1,273 @@
+#include "cholesky.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "config.h"
+#include "time.h"
+
+#define ND_LEAF 64 // boxes with less grid points than this are not split anymore
+
+static chol_symbolic symbolic = {NULL, 0, NULL, NULL, NULL, NULL};
+static cholesky cache[CHOL_CACHE_SIZE];
+static int cache_age[CHOL_CACHE_SIZE];
+static int cache_clock = 0;
+
+/// @brief orders the unknowns of the box [x0,x1) x [y0,y1) of the grid, the two halves
+///        first and the separator line (which cuts the 5 and 9 point stencils) last
+static void nd_box(problem *s, int x0, int x1, int y0, int y1, int *perm, int *k) {
+    if (x1 <= x0 || y1 <= y0) return;
+    if ((x1-x0) * (y1-y0) <= ND_LEAF) {
+        for (int iy = y0; iy < y1; iy++)
+            for (int ix = x0; ix < x1; ix++)
+                if (s->inds[ix + s->nx*iy] != -1) perm[(*k)++] = s->inds[ix + s->nx*iy];
+        return;
+    }
+    if (x1-x0 >= y1-y0) {
+        int xm = (x0 + x1) / 2;
+        nd_box(s, x0, xm, y0, y1, perm, k);
+        nd_box(s, xm+1, x1, y0, y1, perm, k);
+        nd_box(s, xm, xm+1, y0, y1, perm, k);
+    } else {
+        int ym = (y0 + y1) / 2;
+        nd_box(s, x0, x1, y0, ym, perm, k);
+        nd_box(s, x0, x1, ym+1, y1, perm, k);
+        nd_box(s, x0, x1, ym, ym+1, perm, k);
+    }
+}
+
+/// @brief Nested dissection ordering computed from the geometry of the grid
+/// @param s the problem object (its inds array has to be filled by generate_mat)
+/// @param perm perm[k] is the unknown to eliminate at step k (n integers)
+/// @return integer for error handling
+int nested_dissection(problem *s, int *perm) {
+    int k = 0;
+    nd_box(s, 0, s->nx, 0, s->ny, perm, &k);
+    return k == s->n ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// @brief nonzero pattern of row k of L (columns < k) in topological order, in stack[top..n)
+/// @return top
+static int ereach(chol_symbolic *sym, int k, int *mark, int *stack) {
+    problem *s = sym->p;
+    int top = sym->n, row = sym->perm[k];
+    mark[k] = k;
+    for (csr_off j = s->ia[row]; j < s->ia[row+1]; j++) {
+        int i = sym->iperm[s->ja[j]];
+        if (i > k) continue;
+        int len = 0;
+        for (; mark[i] != k; i = sym->parent[i]) {
+            stack[len++] = i;
+            mark[i] = k;
+        }
+        while (len > 0) stack[--top] = stack[--len];
+    }
+    return top;
+}
+
+/// @brief frees the symbolic factorization
+static void free_symbolic(void) {
+    free(symbolic.perm); free(symbolic.parent); free(symbolic.lp);
+    symbolic.perm = symbolic.parent = symbolic.lp = NULL;
+    symbolic.p = NULL;
+}
+
+/// @brief Symbolic factorization : ordering, elimination tree and column counts of L
+/// @return integer for error handling
+static int analyse(problem *s) {
+    int n = s->n;
+    free_symbolic();
+    symbolic.p = s;
+    symbolic.n = n;
+    symbolic.perm = (int*)malloc(2 * n * sizeof(int));
+    symbolic.parent = (int*)malloc(n * sizeof(int));
+    symbolic.lp = (int*)malloc((n + 1) * sizeof(int));
+    int *work = (int*)malloc(3 * n * sizeof(int));
+    if (symbolic.perm == NULL || symbolic.parent == NULL || symbolic.lp == NULL || work == NULL) {
+        printf("\n ERROR : not enough memory for the symbolic factorization\n\n");
+        return EXIT_FAILURE;
+    }
+    symbolic.iperm = symbolic.perm + n;
+    int *ancestor = work, *mark = work + n, *stack = work + 2*n;
+
+    if (nested_dissection(s, symbolic.perm)) return EXIT_FAILURE;
+    for (int k = 0; k < n; k++) symbolic.iperm[symbolic.perm[k]] = k;
+
+    /* elimination tree of the permuted matrix (Liu), with path compression */
+    for (int k = 0; k < n; k++) {
+        symbolic.parent[k] = -1;
+        ancestor[k] = -1;
+        int row = symbolic.perm[k];
+        for (csr_off j = s->ia[row]; j < s->ia[row+1]; j++) {
+            int i = symbolic.iperm[s->ja[j]];
+            while (i != -1 && i < k) {
+                int next = ancestor[i];
+                ancestor[i] = k;
+                if (next == -1) symbolic.parent[i] = k;
+                i = next;
+            }
+        }
+    }
+
+    /* column counts : row k of L adds one to every column of its row subtree */
+    int *count = ancestor; // ancestor is not needed anymore
+    for (int k = 0; k < n; k++) { count[k] = 1; mark[k] = -1; }
+    for (int k = 0; k < n; k++) {
+        for (int top = ereach(&symbolic, k, mark, stack); top < n; top++) count[stack[top]]++;
+    }
+    symbolic.lp[0] = 0;
+    for (int k = 0; k < n; k++) symbolic.lp[k+1] = symbolic.lp[k] + count[k];
+
+    free(work);
+    return EXIT_SUCCESS;
+}
+
+/// @brief Numeric factorization (up-looking, row by row) of P (alpha*I + beta*M) P^T = L L^T
+/// @return integer for error handling
+static int factorize(cholesky *f) {
+    chol_symbolic *sym = f->sym;
+    problem *s = sym->p;
+    int n = sym->n;
+    int nnz = sym->lp[n];
+
+    f->li = (int*)malloc(nnz * sizeof(int));
+    f->lx = (double*)malloc(nnz * sizeof(double));
+    f->work = (double*)malloc(n * sizeof(double));
+    int *work = (int*)malloc(3 * n * sizeof(int));
+    double *x = (double*)calloc(n, sizeof(double));
+    if (f->li == NULL || f->lx == NULL || f->work == NULL || work == NULL || x == NULL) {
+        printf("\n ERROR : not enough memory for the cholesky factor (%d non-zeros)\n\n", nnz);
+        return EXIT_FAILURE;
+    }
+    int *c = work, *mark = work + n, *stack = work + 2*n;
+    for (int k = 0; k < n; k++) { c[k] = sym->lp[k]; mark[k] = -1; }
+
+    for (int k = 0; k < n; k++) {
+        /* scatter the upper part of column k of the permuted matrix */
+        int row = sym->perm[k];
+        for (csr_off j = s->ia[row]; j < s->ia[row+1]; j++) {
+            int i = sym->iperm[s->ja[j]];
+            if (i <= k) x[i] += f->beta * f->vals[j];
+        }
+        x[k] += f->alpha;
+        double d = x[k];
+        x[k] = 0;
+
+        /* triangular solve with the columns of the row subtree */
+        for (int top = ereach(sym, k, mark, stack); top < n; top++) {
+            int i = stack[top];
+            double lki = x[i] / f->lx[sym->lp[i]];
+            x[i] = 0;
+            for (int p = sym->lp[i] + 1; p < c[i]; p++) x[f->li[p]] -= f->lx[p] * lki;
+            d -= lki * lki;
+            int p = c[i]++;
+            f->li[p] = k;
+            f->lx[p] = lki;
+        }
+        if (d <= 0) {
+            printf("\n ERROR : the matrix is not positive definite (pivot %d)\n\n", k);
+            free(work); free(x);
+            return EXIT_FAILURE;
+        }
+        int p = c[k]++;
+        f->li[p] = k;
+        f->lx[p] = sqrt(d);
+    }
+
+    free(work); free(x);
+    return EXIT_SUCCESS;
+}
+
+/// @brief y = L^{-1} P b, b and y can be the same vector only if the permutation is the identity
+void cholesky_lsolve(cholesky *f, double *b, double *y) {
+    chol_symbolic *sym = f->sym;
+    for (int k = 0; k < sym->n; k++) y[k] = b[sym->perm[k]];
+    for (int j = 0; j < sym->n; j++) {
+        y[j] /= f->lx[sym->lp[j]];
+        for (int p = sym->lp[j] + 1; p < sym->lp[j+1]; p++) y[f->li[p]] -= f->lx[p] * y[j];
+    }
+}
+
+/// @brief x = P^T L^{-T} y, y is overwritten
+void cholesky_ltsolve(cholesky *f, double *y, double *x) {
+    chol_symbolic *sym = f->sym;
+    for (int j = sym->n - 1; j >= 0; j--) {
+        for (int p = sym->lp[j] + 1; p < sym->lp[j+1]; p++) y[j] -= f->lx[p] * y[f->li[p]];
+        y[j] /= f->lx[sym->lp[j]];
+    }
+    for (int k = 0; k < sym->n; k++) x[sym->perm[k]] = y[k];
+}
+
+/// @brief solves (alpha*I + beta*M) x = b with the factor
+/// @param b right hand side
+/// @param x solution, can be the same vector as b
+/// @return integer for error handling
+int cholesky_solve(cholesky *f, double *b, double *x) {
+    cholesky_lsolve(f, b, f->work);
+    cholesky_ltsolve(f, f->work, x);
+    return EXIT_SUCCESS;
+}
+
+/// @brief frees a factor of the cache
+static void free_factor(cholesky *f) {
+    free(f->li); free(f->lx); free(f->work);
+    f->li = NULL; f->lx = NULL; f->work = NULL;
+    f->sym = NULL;
+}
+
+/// @brief Gives the cholesky factor of alpha*I + beta*M where M has the pattern (ia, ja) of the
+///        problem matrix and the values vals (s->a for the problem matrix).
+///        Factors are cached with (problem, vals, alpha, beta) as key : A (0, 1), A - sigma*I (-sigma, 1)
+///        and I + dt*D*A (1, dt*D) only get factored once, the ordering and symbolic part once per problem.
+/// @param s the problem object, its matrix has to be generated
+/// @return the factor (owned by the cache), NULL on failure
+/// @attention the values of vals should not change while the factor is in use
+cholesky *cholesky_get(problem *s, double *vals, double alpha, double beta) {
+    double ti, tf;
+    cache_clock++;
+    int oldest = 0;
+    for (int e = 0; e < CHOL_CACHE_SIZE; e++) {
+        cholesky *f = &cache[e];
+        if (f->sym == &symbolic && symbolic.p == s && f->vals == vals && f->alpha == alpha && f->beta == beta) {
+            cache_age[e] = cache_clock;
+            return f;
+        }
+        if (f->sym == NULL) { oldest = e; cache_age[e] = -1; }
+        else if (cache_age[e] < cache_age[oldest]) oldest = e;
+    }
+
+    if (symbolic.p != s || symbolic.n != s->n) {
+        for (int e = 0; e < CHOL_CACHE_SIZE; e++) free_factor(&cache[e]);
+        tic(mytimer_wall, ti);
+        if (analyse(s)) return NULL;
+        tf = mytimer_wall();
+        printf("-> time taken for nested dissection and symbolic factorization was %e seconds (nnz(L) = %d)\n",
+               tf-ti, symbolic.lp[s->n]);
+    }
+
+    cholesky *f = &cache[oldest];
+    free_factor(f);
+    f->sym = &symbolic;
+    f->vals = vals;
+    f->alpha = alpha;
+    f->beta = beta;
+    tic(mytimer_wall, ti);
+    if (factorize(f)) {
+        free_factor(f);
+        return NULL;
+    }
+    tf = mytimer_wall();
+    printf("-> time taken for cholesky factorization of %g I + %g M was %e seconds\n", alpha, beta, tf-ti);
+    cache_age[oldest] = cache_clock;
+
+    f->solve = cholesky_solve;
+    f->lsolve = cholesky_lsolve;
+    f->ltsolve = cholesky_ltsolve;
+    return f;
+}
+
+/// @brief drops every cached factor of the problem (called when the problem is freed)
+void cholesky_forget(problem *s) {
+    if (symbolic.p != s) return;
+    for (int e = 0; e < CHOL_CACHE_SIZE; e++) free_factor(&cache[e]);
+    free_symbolic();
+}
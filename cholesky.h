@@ -0,0 +1,34 @@
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+
+#include "prob.h"
+
+typedef struct sCholSymbolic chol_symbolic;
+struct sCholSymbolic {
+    problem *p; // the pattern (and the grid for the ordering) comes from this problem
+    int n;
+    int *perm, *iperm; // perm[k] is the unknown eliminated at step k (nested dissection)
+    int *parent; // elimination tree
+    int *lp; // column pointers of L
+};
+
+typedef struct sCholesky cholesky;
+struct sCholesky {
+    chol_symbolic *sym;
+    double *vals; // values of the CSR matrix, with alpha and beta they are the key of the factor
+    double alpha, beta; // the factored matrix is alpha*I + beta*(ia, ja, vals)
+    int *li; // row indices of L, the diagonal is the first element of each column
+    double *lx;
+    double *work; // n vector of solve(), allocated with the factor
+    int (*solve)(cholesky*, double*, double*);
+    void (*lsolve)(cholesky*, double*, double*);
+    void (*ltsolve)(cholesky*, double*, double*);
+};
+
+int nested_dissection(problem *s, int *perm);
+
+cholesky *cholesky_get(problem *s, double *vals, double alpha, double beta);
+
+void cholesky_forget(problem *s);
+
+#endif // !CHOLESKY_H
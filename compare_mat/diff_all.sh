@@ -1,3 +1,3 @@
-diff a_gen.txt a.5.txt
-diff ia_gen.txt ia.5.txt
-diff ja_gen.txt ja.5.txt
\ No newline at end of file
+# the text references are converted once to the binary container, then compared with the extracted matrix
+[ -e mat_ref.csr ] || ../csrdiff --import ia.5.txt ja.5.txt a.5.txt mat_ref.csr
+../csrdiff mat_gen.csr mat_ref.csr
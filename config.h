@@ -3,11 +3,27 @@
 
 #define M_UNIT_STEPS 20
 // number of points for the lenght of a unit square
+#define RICHARDSON_LEVELS 0
+/* if > 2, the minimal eigenvalue is first extrapolated from the grids m = (RICHARDSON_M0-1) 2^k + 1,
+   k < RICHARDSON_LEVELS, each solve starting from the previous eigenvector */
+#define RICHARDSON_M0 5 // coarsest grid of the richardson driver
+#define HOLE_OPTIMIZER 0
+/* the hole (same size) is first moved on the grid of M_UNIT_STEPS to a local maximum of the minimal eigenvalue,
+   following its shape derivative from the eigenvector of each solve, the rest of the run uses the optimized hole */
+#define HOLEOPT_STEP 8 // first move of the hole in grid cells, halved when a move does not increase lambda
+#define HOLEOPT_MAX_SOLVES 60
+#define STENCIL_9PT 0
+/* compact fourth order (Mehrstellen) 9 point stencil : generalized problem A u = lambda B u,
+   primme and the heat evolution go through the cholesky factorization of B, slepc solves it as a GHEP.
+   the fast poisson solver, the ensemble mode and USE_MPI need the 5 point stencil */
 
 #define EXTRACT_MAT 1
-/* will extract the matrix to ./compare_mat
+/* will extract the matrix to EXTRACT_MAT_FILE (binary CSR container), 2 also writes the Matrix Market file
 /!\ to verify with reference matrix, use M_UNIT_STEPS=3 
-and then do ./diff_all.sh inside folder */
+and then do ./diff_all.sh inside folder (make csrdiff first) */
+#define EXTRACT_MAT_FILE "./compare_mat/mat_gen.csr"
+#define EXTRACT_MAT_MARKET "./compare_mat/mat_gen.mtx"
+#define LOAD_MAT "" // container of csr_save() read instead of generating the matrix ("" : generated), it holds the geometry
 
 #define PRIMME_CONFIG_PRINT 1
 // print solver config before solving
@@ -21,6 +37,56 @@ and then do ./diff_all.sh inside folder */
 #define DISPLAY_EIGENVEC 1
 // display the eigen vector for min eigen value from primme
 
+#define SPECTRAL_BOUND 1
+/* dt max is taken from a gershgorin + lanczos upper bound of the max eigenvalue
+   instead of a full primme solve for the maximal eigenvalue */
+#define LANCZOS_STEPS 20 // number of lanczos steps (matvecs) for the bound
+#define LANCZOS_SAFETY 1.01 // safety margin applied on the lanczos estimate
+
+#define CHOL_CACHE_SIZE 4 // number of cholesky factorizations (A, A - sigma I, I + dt D A...) kept in memory
+#define PRIMME_SHIFT_INVERT 0
+// primme solves for the largest eigenvalue of (A - sigma I)^-1 with a cached cholesky factorization
+#define SLEPC_SHIFT_INVERT 0
+// same for slepc with krylov-schur and a shell spectral transformation instead of blopex
+#define SHIFT_INVERT_SIGMA 0.0 // shift, has to stay below the minimal eigenvalue
+#define MIXED_PRECISION 0
+/* the minimal eigenvalue is first solved with the values of A in single precision, then refined by a few
+   Jacobi-Davidson steps : residual in double, correction equations solved by CG with the single precision values
+   (not used with STENCIL_9PT or PRIMME_SHIFT_INVERT) */
+#define MIXED_FLOAT_EPS 1e-7 // primme tolerance of the single precision phase
+// the refinement stops at the tolerance of the all double solve (primme.eps * ||A||, gershgorin)
+#define MIXED_REFINE_STEPS 5 // at most, one double matvec each, plus the correction solve once it goes to double
+#define MIXED_CG_TOL 1e-3 // reduction of the residual of the correction equation
+#define MIXED_CG_MAXIT 2000
+#define KERNEL_LIBRARY 0
+/* matvec_primme, temperature_iterate, calc_res and compare_vecs go through the C++ kernels (kernels.cpp)
+   specialized on the scalar type, the block width and the operator variant */
+#define KERNEL_VARIANT 0 // 0 : CSR rows, 1 : upper triangle (symmetric), 2 : matrix-free 5 point stencil
+#define FAST_POISSON_PRECOND 0
+// primme preconditioner A^-1 applied with sine transforms on the full rectangle and a capacitance matrix for the hole
+#define EIGEN_SOLVER 1
+/* backend of the minimal eigenvalue solve : 0 native LOBPCG (lobpcg.c), 1 primme, 2 slepc,
+   -1 chosen from n, the number of eigenpairs and the timings of the previous solves */
+#define SOLVER_NATIVE_N 50000 // without timings, LOBPCG is chosen up to this number of unknowns
+#define SOLVER_HISTORY "./solver_history.txt" // timings of the previous solves, read and appended with EIGEN_SOLVER -1 only, "" to keep none
+#define LOBPCG_TOL 1e-12 // residual norm relative to the gershgorin bound of ||A||
+#define LOBPCG_MAXIT 5000
+#define LARGE_GRID 0
+/* 64 bit row offsets (ia, nnz) and file-backed storage (mmap) of ia, ja, a and the eigenvectors in LARGE_GRID_DIR,
+   the matvec streams the rows by blocks with read-ahead. KERNEL_LIBRARY, MIXED_PRECISION and the cholesky
+   factorizations still keep their own copies of the matrix in memory, slepc is not available */
+#define LARGE_GRID_DIR "/tmp" // directory of the backing files (unlinked), 12 to 20 bytes per non-zero
+#define STREAM_ROWS 65536 // rows per block of the streamed matvec
+#if LARGE_GRID && (SOLVING_WITH_SLEPC || EIGEN_SOLVER == 2)
+#error "slepc copies the matrix into a PETSc AIJ matrix in memory, set SOLVING_WITH_SLEPC 0 and EIGEN_SOLVER != 2 with LARGE_GRID"
+#endif
+#define ARENA_ALLOCATOR 0
+/* the arrays of a problem (inds, ia, ja, a, b) and the vectors of main.c and of the richardson driver come
+   from one region with 64 byte alignment, released at once by p.close and kept for the next problems */
+#define ARENA_HUGE_PAGES 1 // 0 : 4K pages, 1 : transparent huge pages, 2 : explicit huge pages (vm.nr_hugepages)
+#define ARENA_VECTORS 4 // vectors of n doubles reserved in the arena (eigenvectors, uk and vk)
+#define ARENA_CACHE 2 // released regions kept mapped for reuse
+
 #define SHOW_TEMPERATURE_EVOL 1
 // DT max is the limit for the progressive euler method to converge
 #define DT_F 10 // fraction of DT max, dt = dt_max / DT_F
@@ -28,6 +94,34 @@ and then do ./diff_all.sh inside folder */
 #define ISR 100 // inverse sampling rate, for instance, 10 would mean that 1/10 iteration will be displayed
 #define INITIAL_TEMP 10 // initial temperature
 #define DIFFUSIVITY 9.7e-5 // diffusivity
+#define RKC_INTEGRATOR 1
+// runge-kutta-chebyshev method with adaptive steps instead of the progressive euler method,
+// DT_F then only sets the spacing of the frames (ISR * dt_max / DT_F seconds), not the step
+#define RKC_TOL 1e-5 // tolerance for the embedded error estimate of the RKC method
+#define IMPLICIT_EULER 0
+// backward euler method with a cached cholesky factorization of I + dt D A, used if RKC_INTEGRATOR is 0
+#define IMPLICIT_DT 100 // in seconds, the time step of the backward euler method (no stability limit)
+#define FAST_POISSON_SOLVER 0 // the backward euler steps use the fast poisson solver instead of cholesky
+#define STEADY_STATE_TOL 1e-6 // the loop stops when the rms of du/dt (temperature/s) goes below this value
+#define FRAME_TOL 0.05 // a frame is only displayed if the temperature changed by more than this since the last one
+#define CHECKPOINT_EVERY 0
+/* frames of the heat loop between two checkpoints written by a background thread (0 : none), a checkpoint
+   is also written on SIGTERM. ./executable_to_wrap --restart resumes the loop, max eigen value included */
+#define CHECKPOINT_FILE "./heat_checkpoint.bin"
+
+#define USE_MPI 0
+/* distributed heat evolution and slepc solve on strips of the grid, run with mpirun -np N ./executable_to_wrap
+   petsc has to be configured with mpi (see install) */
+
+#define ENSEMBLE_MODE 0
+// advances ENSEMBLE_SIZE independent temperature fields together, the matrix is read once per step for all of them
+#define ENSEMBLE_SIZE 4
+#define ENSEMBLE_DIFFUSIVITY {9.7e-5, 1.11e-4, 2.3e-5, 1.9e-5} // diffusivity of each member
+#define ENSEMBLE_INITIAL_TEMP {10, 10, 20, 5} // initial temperature of each member
+
+#if STENCIL_9PT && (ENSEMBLE_MODE || USE_MPI || FAST_POISSON_PRECOND)
+#error "the 9 point stencil is not supported by the ensemble mode, USE_MPI and the fast poisson preconditioner"
+#endif
 
 #define broadcast(msg)\
   printf(ANSI_COLOR_YELLOW "-----");\
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "csrfile.h"
+#include "config.h"
+
+/// @brief row holding the element k of a mapped container (binary search on ia)
+static int row_of(const csr_view *v, long long k) {
+    int lo = 0, hi = v->h.n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (csr_offset(v, mid) <= k) lo = mid; else hi = mid - 1;
+    }
+    return lo;
+}
+
+/// @brief compares the values of the two matrices (same pattern) with a tolerance relative to the largest of u
+/// @return 1 if they differ by more than tol
+static int compare_values(const char *name, const csr_view *u, const double *x, const double *y, double tol) {
+    long long nnz = u->h.nnz;
+    if (memcmp(x, y, nnz * sizeof(double)) == 0) {
+        printf("%-3s : identical\n", name);
+        return 0;
+    }
+    double xmax = 0, dmax = 0;
+    long long kmax = 0;
+    for (long long k = 0; k < nnz; k++) {
+        xmax = fmax(xmax, fabs(x[k]));
+        double d = fabs(x[k] - y[k]);
+        if (d > dmax || d != d) {
+            dmax = d;
+            kmax = k;
+        }
+    }
+    double rel = (xmax > 0) ? dmax / xmax : dmax;
+    printf("%-3s : max difference %e (relative %e) at row %d, column %d\n", name, dmax, rel, row_of(u, kmax), u->ja[kmax]);
+    return !(rel <= tol);
+}
+
+/// @brief compares two containers : pattern (ia, ja) exactly, values (a, b) within tol
+/// @return 0 if they match, 1 otherwise
+static int compare(const csr_view *u, const csr_view *v, double tol) {
+    const csr_header *hu = &u->h, *hv = &v->h;
+    int diff = 0;
+    if (hu->n != hv->n || hu->nnz != hv->nnz || hu->stencil != hv->stencil) {
+        printf("n = %d / %d, nnz = %lld / %lld, stencil %d / %d points : the matrices differ\n",
+               hu->n, hv->n, hu->nnz, hv->nnz, hu->stencil, hv->stencil);
+        return 1;
+    }
+    printf("n = %d   nnz = %lld   %d point stencil\n", hu->n, hu->nnz, hu->stencil);
+    if (hu->m != 0 && hv->m != 0 && (hu->m != hv->m || hu->nx != hv->nx || hu->ny != hv->ny
+        || memcmp(&hu->shape, &hv->shape, sizeof(pos2d)) || memcmp(&hu->hole, &hv->hole, sizeof(Rectangle)))) {
+        printf("geometry differs : m = %d / %d, hole [%d, %d] x [%d, %d] / [%d, %d] x [%d, %d]\n", hu->m, hv->m,
+               hu->hole.x[0], hu->hole.x[1], hu->hole.y[0], hu->hole.y[1],
+               hv->hole.x[0], hv->hole.x[1], hv->hole.y[0], hv->hole.y[1]);
+        diff = 1;
+    }
+
+    if (hu->index_width != hv->index_width || memcmp(u->ia, v->ia, (size_t)(hu->n + 1) * hu->index_width)) {
+        for (int i = 0; i <= hu->n; i++) {
+            if (csr_offset(u, i) != csr_offset(v, i)) {
+                printf("ia  : first difference at row %d (%lld / %lld)\n", i, csr_offset(u, i), csr_offset(v, i));
+                return 1; // the values can not be compared element by element
+            }
+        }
+    }
+    printf("ia  : identical\n");
+
+    if (memcmp(u->ja, v->ja, hu->nnz * sizeof(int))) {
+        long long k = 0;
+        while (u->ja[k] == v->ja[k]) k++;
+        printf("ja  : first difference at row %d (column %d / %d)\n", row_of(u, k), u->ja[k], v->ja[k]);
+        return 1;
+    }
+    printf("ja  : identical\n");
+
+    diff |= compare_values("a", u, u->a, v->a, tol);
+    if (u->b != NULL) diff |= compare_values("b", u, u->b, v->b, tol);
+    return diff;
+}
+
+/// @brief reads a text file with one number per line, the format of the former extract_mat
+/// @param real 1 for doubles, 0 for integers (read as long long)
+/// @return the array, NULL if the file can not be read
+static void *read_text(const char *path, int real, long long *count) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("\n ERROR : cannot open %s\n\n", path);
+        return NULL;
+    }
+    long long cap = 1024;
+    char *v = (char*)malloc(cap * 8);
+    *count = 0;
+    while (v != NULL) {
+        if (*count == cap) {
+            cap *= 2;
+            char *grown = (char*)realloc(v, cap * 8);
+            if (grown == NULL) {
+                free(v);
+                v = NULL;
+                break;
+            }
+            v = grown;
+        }
+        int ok = real ? fscanf(f, "%lf", (double*)v + *count) : fscanf(f, "%lld", (long long*)v + *count);
+        if (ok != 1) break;
+        (*count)++;
+    }
+    fclose(f);
+    if (v == NULL) printf("\n ERROR : not enough memory to read %s\n\n", path);
+    return v;
+}
+
+/// @brief converts the three text files of the former extract_mat (references of compare_mat) to a container
+/// @return integer for error handling
+static int import_text(const char *pia, const char *pja, const char *pa, const char *out) {
+    long long nia, nja, na;
+    long long *ia = (long long*)read_text(pia, 0, &nia);
+    long long *ja = (long long*)read_text(pja, 0, &nja);
+    double *a = (double*)read_text(pa, 1, &na);
+    if (ia == NULL || ja == NULL || a == NULL) return EXIT_FAILURE;
+    if (nia < 1 || ia[0] != 0 || ia[nia-1] != nja || nja != na) {
+        printf("\n ERROR : %s, %s and %s are not a CSR matrix (%lld offsets, %lld columns, %lld values)\n\n",
+               pia, pja, pa, nia, nja, na);
+        return EXIT_FAILURE;
+    }
+    int *ja32 = (int*)malloc(nja * sizeof(int) + 1);
+    if (ja32 == NULL) {
+        printf("\n ERROR : not enough memory for the columns\n\n");
+        return EXIT_FAILURE;
+    }
+    for (long long k = 0; k < nja; k++) ja32[k] = (int)ja[k];
+
+    csr_header h;
+    csr_init_header(&h, (int)(nia - 1), nja, sizeof(long long), 5);
+    int err = csr_write(out, &h, ia, ja32, a, NULL);
+    if (!err) printf("%s : n = %d   nnz = %lld\n", out, h.n, h.nnz);
+    free(ia); free(ja); free(a); free(ja32);
+    return err;
+}
+
+/// @brief compares two binary CSR containers (EXTRACT_MAT_FILE), the pattern has to be identical and the values
+/// equal within a tolerance relative to the largest value of the first matrix (default 1e-14)
+/// usage : ./csrdiff mat.csr reference.csr [tol]
+///         ./csrdiff --import ia.txt ja.txt a.txt reference.csr (text files of the former extract_mat)
+/// @return 0 if the matrices match, 1 if they differ, 2 on error (as diff)
+int main(int argc, char *argv[])
+{
+    if (argc == 6 && !strcmp(argv[1], "--import")) {
+        return import_text(argv[2], argv[3], argv[4], argv[5]) ? 2 : 0;
+    }
+    if (argc != 3 && argc != 4) {
+        printf("usage : %s mat.csr reference.csr [tol]\n", argv[0]);
+        printf("        %s --import ia.txt ja.txt a.txt reference.csr\n", argv[0]);
+        return 2;
+    }
+    double tol = (argc > 3) ? atof(argv[3]) : 1e-14;
+    csr_view u, v;
+    if (csr_map(argv[1], &u)) return 2;
+    if (csr_map(argv[2], &v)) return 2;
+    int diff = compare(&u, &v, tol);
+    printf("%s\n", diff ? "the matrices differ" : "the matrices match");
+    csr_unmap(&u);
+    csr_unmap(&v);
+    return diff;
+}
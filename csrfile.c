@@ -0,0 +1,242 @@
+#include "csrfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.h"
+
+#define CSR_MAGIC "MEMBCSR"
+#define CSR_VERSION 1
+#define align8(x) (((x) + 7) & ~(size_t)7)
+
+/// @brief offsets of ia, ja, a and b in the container
+/// @return size of the container
+static size_t layout(const csr_header *h, size_t off[4]) {
+    off[0] = align8(sizeof(csr_header));
+    off[1] = off[0] + align8((size_t)(h->n + 1) * h->index_width);
+    off[2] = off[1] + align8((size_t)h->nnz * sizeof(int));
+    off[3] = off[2] + (size_t)h->nnz * sizeof(double);
+    return off[3] + (h->stencil == 9 ? (size_t)h->nnz * sizeof(double) : 0);
+}
+
+/// @brief FNV-1a hash of the arrays, taken by 8 bytes words so that it stays far below the cost of the write
+static unsigned long long checksum(const unsigned char *c, size_t bytes) {
+    unsigned long long h = 14695981039346656037ULL, w;
+    size_t k = 0;
+    for (; k + 8 <= bytes; k += 8) {
+        memcpy(&w, c + k, 8);
+        h = (h ^ w) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    for (; k < bytes; k++) h = (h ^ c[k]) * 1099511628211ULL;
+    return h;
+}
+
+/// @brief fills the header of a container without geometry (m = 0)
+void csr_init_header(csr_header *h, int n, long long nnz, int index_width, int stencil) {
+    memset(h, 0, sizeof(csr_header));
+    memcpy(h->magic, CSR_MAGIC, sizeof(h->magic));
+    h->version = CSR_VERSION;
+    h->index_width = index_width;
+    h->n = n;
+    h->stencil = stencil;
+    h->nnz = nnz;
+}
+
+/// @brief writes a container with a single shared mapping of the file : the arrays are copied in place,
+/// the checksum is computed on the mapping and the header written last
+/// @param h header, its checksum is computed here
+/// @param ia row offsets of h->index_width bytes
+/// @param b mass matrix, only read if h->stencil is 9
+/// @return integer for error handling
+int csr_write(const char *path, const csr_header *h, const void *ia, const int *ja, const double *a, const double *b) {
+    size_t off[4];
+    size_t bytes = layout(h, off);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        printf("\n ERROR : cannot create %s\n\n", path);
+        return EXIT_FAILURE;
+    }
+    /* the blocks are reserved now, a full disk would otherwise be a SIGBUS during the copy */
+    if (ftruncate(fd, bytes) || posix_fallocate(fd, 0, bytes)) {
+        printf("\n ERROR : not enough space for %s (%zu bytes)\n\n", path, bytes);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    unsigned char *f = (unsigned char*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (f == MAP_FAILED) {
+        printf("\n ERROR : cannot map %s\n\n", path);
+        return EXIT_FAILURE;
+    }
+    madvise(f, bytes, MADV_SEQUENTIAL);
+    memcpy(f + off[0], ia, (size_t)(h->n + 1) * h->index_width);
+    memcpy(f + off[1], ja, (size_t)h->nnz * sizeof(int));
+    memcpy(f + off[2], a, (size_t)h->nnz * sizeof(double));
+    if (h->stencil == 9) memcpy(f + off[3], b, (size_t)h->nnz * sizeof(double));
+
+    csr_header hd = *h;
+    hd.checksum = checksum(f + off[0], bytes - off[0]);
+    memcpy(f, &hd, sizeof(csr_header));
+    int synced = msync(f, bytes, MS_SYNC) == 0; // the container is on disk when EXIT_SUCCESS is returned
+    if (munmap(f, bytes) || !synced) {
+        printf("\n ERROR : %s could not be written\n\n", path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/// @brief writes the matrix of the problem (and the mass matrix of the 9 point stencil) with its geometry
+/// @return integer for error handling
+int csr_save(problem *s, const char *path) {
+    csr_header h;
+    csr_init_header(&h, s->n, s->ia[s->n] - s->ia[0], sizeof(csr_off), s->b == NULL ? 5 : 9);
+    h.m = s->m;
+    h.nx = s->nx;
+    h.ny = s->ny;
+    h.shape = s->m_s;
+    h.hole = s->i_s;
+    return csr_write(path, &h, s->ia, s->ja, s->a, s->b);
+}
+
+/// @brief maps a container read-only and checks its header, size and checksum
+/// @param v holds the header and the arrays (pointers into the mapping) until csr_unmap()
+/// @return integer for error handling
+int csr_map(const char *path, csr_view *v) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        printf("\n ERROR : cannot open %s\n\n", path);
+        return EXIT_FAILURE;
+    }
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(csr_header)) {
+        printf("\n ERROR : %s is not a CSR container\n\n", path);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    v->bytes = st.st_size;
+    v->base = mmap(NULL, v->bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (v->base == MAP_FAILED) {
+        printf("\n ERROR : cannot map %s\n\n", path);
+        return EXIT_FAILURE;
+    }
+    madvise(v->base, v->bytes, MADV_SEQUENTIAL);
+
+    csr_header *h = &v->h;
+    memcpy(h, v->base, sizeof(csr_header));
+    size_t off[4];
+    if (memcmp(h->magic, CSR_MAGIC, sizeof(h->magic)) || h->version != CSR_VERSION
+        || (h->index_width != 4 && h->index_width != 8) || (h->stencil != 5 && h->stencil != 9)
+        || h->n < 0 || h->nnz < 0) {
+        printf("\n ERROR : %s is not a CSR container of this version of the program\n\n", path);
+        csr_unmap(v);
+        return EXIT_FAILURE;
+    }
+    if (layout(h, off) != v->bytes) {
+        printf("\n ERROR : %s is truncated (%zu bytes instead of %zu)\n\n", path, v->bytes, layout(h, off));
+        csr_unmap(v);
+        return EXIT_FAILURE;
+    }
+    unsigned char *f = (unsigned char*)v->base;
+    if (checksum(f + off[0], v->bytes - off[0]) != h->checksum) {
+        printf("\n ERROR : the arrays of %s are corrupted\n\n", path);
+        csr_unmap(v);
+        return EXIT_FAILURE;
+    }
+    v->ia = f + off[0];
+    v->ja = (const int*)(f + off[1]);
+    v->a = (const double*)(f + off[2]);
+    v->b = (h->stencil == 9) ? (const double*)(f + off[3]) : NULL;
+    return EXIT_SUCCESS;
+}
+
+/// @brief releases the mapping of csr_map()
+void csr_unmap(csr_view *v) {
+    munmap(v->base, v->bytes);
+    v->base = NULL;
+}
+
+/// @brief row offset i of a mapped container, whatever its index width
+long long csr_offset(const csr_view *v, int i) {
+    if (v->h.index_width == 4) return ((const int*)v->ia)[i];
+    return ((const long long*)v->ia)[i];
+}
+
+/// @brief Initializes the problem object from a container written by csr_save() : the geometry comes from
+/// the header and the arrays are copied from the mapping, generate_mat does not have to be called
+/// @param s The yet unitialized object
+/// @return integer for error handling
+int csr_load(problem *s, const char *path) {
+    csr_view v;
+    if (csr_map(path, &v)) return EXIT_FAILURE;
+    csr_header *h = &v.h;
+    if (h->m == 0) {
+        printf("\n ERROR : %s has no geometry (imported matrix), it can only be compared with csrdiff\n\n", path);
+        csr_unmap(&v);
+        return EXIT_FAILURE;
+    }
+    if (h->stencil != (STENCIL_9PT ? 9 : 5)) {
+        printf("\n ERROR : %s was written with the %d point stencil\n\n", path, h->stencil);
+        csr_unmap(&v);
+        return EXIT_FAILURE;
+    }
+    if (init_problem_grid(s, h->m, h->shape, h->hole)) {
+        csr_unmap(&v);
+        return EXIT_FAILURE;
+    }
+    if (s->n != h->n || s->nx != h->nx || s->ny != h->ny || h->nnz > s->nnz) {
+        printf("\n ERROR : the matrix of %s does not match its geometry\n\n", path);
+        s->close(s);
+        csr_unmap(&v);
+        return EXIT_FAILURE;
+    }
+
+    generate_inds(s);
+    if (h->index_width == sizeof(csr_off)) {
+        memcpy(s->ia, v.ia, (size_t)(s->n + 1) * sizeof(csr_off));
+    } else {
+        for (int i = 0; i <= s->n; i++) s->ia[i] = csr_offset(&v, i);
+    }
+    memcpy(s->ja, v.ja, h->nnz * sizeof(int));
+    memcpy(s->a, v.a, h->nnz * sizeof(double));
+    if (v.b != NULL) memcpy(s->b, v.b, h->nnz * sizeof(double));
+    s->nnz = h->nnz;
+    csr_unmap(&v);
+    return EXIT_SUCCESS;
+}
+
+/// @brief writes the lower triangle of a matrix with the pattern of the problem in the Matrix Market
+/// format (coordinate real symmetric, indices from 1)
+/// @param values s->a, or s->b for the mass matrix of the 9 point stencil
+/// @return integer for error handling
+int csr_market(problem *s, double *values, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        printf("\n ERROR : cannot create %s\n\n", path);
+        return EXIT_FAILURE;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+    long long lower = 0;
+    for (int i = 0; i < s->n; i++) {
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) lower += (s->ja[j] <= i);
+    }
+    fprintf(f, "%%%%MatrixMarket matrix coordinate real symmetric\n");
+    fprintf(f, "%% membrane : m = %d, shape %d x %d, hole [%d, %d] x [%d, %d] (grid indices)\n",
+            s->m, s->m_s.x, s->m_s.y, s->i_s.x[0], s->i_s.x[1], s->i_s.y[0], s->i_s.y[1]);
+    fprintf(f, "%d %d %lld\n", s->n, s->n, lower);
+    for (int i = 0; i < s->n; i++) {
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) {
+            if (s->ja[j] <= i) fprintf(f, "%d %d %.17g\n", i + 1, s->ja[j] + 1, values[j]);
+        }
+    }
+    if (fclose(f)) {
+        printf("\n ERROR : %s could not be written\n\n", path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
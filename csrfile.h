@@ -0,0 +1,49 @@
+#ifndef CSRFILE_H
+#define CSRFILE_H
+
+#include <stddef.h>
+#include "prob.h"
+
+/* binary CSR container : the header, then ia ((n+1) offsets of index_width bytes), ja (nnz int), a (nnz double)
+   and b (nnz double, 9 point stencil only), each array starting on 8 bytes */
+typedef struct {
+    char magic[8];
+    int version;
+    int index_width; // bytes of the row offsets, 4, or 8 with LARGE_GRID
+    int n;
+    int stencil; // 5 or 9 (b follows a)
+    long long nnz;
+    int m, nx, ny; // geometry of the problem, m = 0 for a matrix imported from text files
+    pos2d shape;
+    Rectangle hole; // grid indices (i_s)
+    unsigned long long checksum; // of everything after the header
+} csr_header;
+
+/* read-only mapping of a container */
+typedef struct {
+    csr_header h;
+    void *base;
+    size_t bytes;
+    const void *ia; // int or long long depending on h.index_width, see csr_offset()
+    const int *ja;
+    const double *a;
+    const double *b; // NULL for the 5 point stencil
+} csr_view;
+
+void csr_init_header(csr_header *h, int n, long long nnz, int index_width, int stencil);
+
+int csr_write(const char *path, const csr_header *h, const void *ia, const int *ja, const double *a, const double *b);
+
+int csr_save(problem *s, const char *path);
+
+int csr_map(const char *path, csr_view *v);
+
+void csr_unmap(csr_view *v);
+
+long long csr_offset(const csr_view *v, int i);
+
+int csr_load(problem *s, const char *path);
+
+int csr_market(problem *s, double *values, const char *path);
+
+#endif // !CSRFILE_H
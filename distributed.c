@@ -0,0 +1,270 @@
+#include "distributed.h"
+
+#if USE_MPI
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdbool.h>
+#include "interface_slepc.h"
+
+#define TAG_DOWN 0 // message sent to the rank below
+#define TAG_UP 1 // message sent to the rank above
+
+/// @brief y = A*x for the local rows [r0, r1)
+static void dist_rows(dist_problem *s, double *y, int r0, int r1) {
+    for (int i = r0; i < r1; i++) {
+        double sum = 0;
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) {
+            sum += s->a[j] * s->x[s->ja[j]];
+        }
+        y[i] = sum;
+    }
+}
+
+/// @brief Distributed matrix-vector product y = A*x, the owned part of x has to be in
+///        s->x + s->nghost_lo. The exchange of the ghosts is overlapped with the interior rows.
+/// @param y the owned rows of the result (nrows doubles)
+/// @return integer for error handling
+int dist_matvec(dist_problem *s, double *y) {
+    MPI_Request req[4];
+    int nreq = 0;
+    double *own = s->x + s->nghost_lo;
+
+    if (s->nghost_lo) MPI_Irecv(s->x, s->nghost_lo, MPI_DOUBLE, s->rank-1, TAG_UP, s->comm, &req[nreq++]);
+    if (s->nghost_hi) MPI_Irecv(own + s->nrows, s->nghost_hi, MPI_DOUBLE, s->rank+1, TAG_DOWN, s->comm, &req[nreq++]);
+    if (s->send_lo) MPI_Isend(own, s->send_lo, MPI_DOUBLE, s->rank-1, TAG_DOWN, s->comm, &req[nreq++]);
+    if (s->send_hi) MPI_Isend(own + s->nrows - s->send_hi, s->send_hi, MPI_DOUBLE, s->rank+1, TAG_UP, s->comm, &req[nreq++]);
+
+    dist_rows(s, y, s->interior0, s->interior1);
+
+    if (MPI_Waitall(nreq, req, MPI_STATUSES_IGNORE) != MPI_SUCCESS) return EXIT_FAILURE;
+
+    dist_rows(s, y, 0, s->interior0);
+    dist_rows(s, y, s->interior1, s->nrows);
+    return EXIT_SUCCESS;
+}
+
+/// @brief frees all heap allocated memory for the local part of the problem
+void close_dist_problem(dist_problem *s) {
+    free(s->ia);
+    free(s->ja);
+    free(s->a);
+    free(s->x);
+}
+
+/// @brief number of unknowns of the grid row iy, the points of the hole are not unknowns
+static int row_unknowns(dist_problem *s, int iy) {
+    if (iy >= s->hole.y[0] && iy <= s->hole.y[1]) return s->nx - (s->hole.x[1] - s->hole.x[0] + 1);
+    return s->nx;
+}
+
+/// @brief numbers the unknowns of the grid rows [gy_lo, gy_hi) in map as generate_inds does for the
+///        whole grid, -1 for the points of the hole
+/// @param first global index of the first unknown of the grid row gy_lo
+static void dist_inds(dist_problem *s, int *map, int gy_lo, int gy_hi, int first) {
+    int ind = first;
+    for (int iy = gy_lo; iy < gy_hi; iy++) {
+        for (int ix = 0; ix < s->nx; ix++) {
+            bool hole = ix >= s->hole.x[0] && ix <= s->hole.x[1] && iy >= s->hole.y[0] && iy <= s->hole.y[1];
+            map[ix + s->nx * (iy - gy_lo)] = hole ? -1 : ind++;
+        }
+    }
+}
+
+/// @brief Splits the grid in strips of grid rows, one per rank, with about the same number of unknowns.
+///        Since the unknowns are numbered row by row, a strip is a contiguous range of rows of A
+///        and its ghosts are contiguous ranges just below and above it. Each rank only numbers the
+///        unknowns of its strip and of the two grid rows around it, and generates its own rows of A.
+/// @param self the yet uninitialized object
+/// @param m the number of grid points for the unit lenght
+/// @param shape the shape of the membrane
+/// @param hole the hole in the grid coordinates system
+/// @param comm communicator of the ranks sharing the problem
+/// @return integer for error handling
+/// @attention there should not be more ranks than grid rows
+int init_dist_problem(dist_problem *self, int m, pos2d shape, Rectangle hole, MPI_Comm comm) {
+    self->comm = comm;
+    MPI_Comm_rank(comm, &self->rank);
+    MPI_Comm_size(comm, &self->size);
+    self->m = m;
+    self->nx = shape.x * (m-1) - 1;
+    self->ny = shape.y * (m-1) - 1;
+    self->hole = hole;
+    if (hole.x[0] < 1 || hole.x[1] > self->nx - 2 || hole.x[0] > hole.x[1]
+        || hole.y[0] < 1 || hole.y[1] > self->ny - 2 || hole.y[0] > hole.y[1]) {
+        if (self->rank == 0) printf("\n ERROR : the hole [%d, %d] x [%d, %d] is not strictly inside the grid\n\n",
+                                    hole.x[0], hole.x[1], hole.y[0], hole.y[1]);
+        return EXIT_FAILURE;
+    }
+    self->n = self->nx * self->ny - (hole.x[1] - hole.x[0] + 1) * (hole.y[1] - hole.y[0] + 1);
+
+    /* grid rows of this rank, the owner of a grid row is the one holding its middle unknown */
+    int c = 0;
+    self->gy0 = self->gy1 = -1;
+    self->row0 = self->nrows = 0;
+    for (int iy = 0; iy < self->ny; iy++) {
+        int count = row_unknowns(self, iy);
+        int owner = (int)(((long long)c + count/2) * self->size / self->n);
+        if (owner == self->rank) {
+            if (self->gy0 < 0) {
+                self->gy0 = iy;
+                self->row0 = c;
+            }
+            self->gy1 = iy + 1;
+            self->nrows += count;
+        }
+        c += count;
+    }
+    int min_rows;
+    MPI_Allreduce(&self->nrows, &min_rows, 1, MPI_INT, MPI_MIN, comm);
+    if (min_rows == 0) {
+        if (self->rank == 0) printf("\n ERROR : too many ranks for %d grid rows\n\n", self->ny);
+        return EXIT_FAILURE;
+    }
+
+    /* numbering of the strip and of the grid rows just below and above it (the halo) */
+    int gy_lo = self->gy0 > 0 ? self->gy0 - 1 : 0;
+    int gy_hi = self->gy1 < self->ny ? self->gy1 + 1 : self->ny;
+    int *map = (int*)malloc((size_t)self->nx * (gy_hi - gy_lo) * sizeof(int));
+    self->ia = (int*)malloc((self->nrows + 1) * sizeof(int));
+    self->ja = (int*)malloc(5 * self->nrows * sizeof(int));
+    self->a = (double*)malloc(5 * self->nrows * sizeof(double));
+    if (map == NULL || self->ia == NULL || self->ja == NULL || self->a == NULL) {
+        printf("\n ERROR : not enough memory for the local matrix of rank %d\n\n", self->rank);
+        free(map);
+        return EXIT_FAILURE;
+    }
+    dist_inds(self, map, gy_lo, gy_hi, self->gy0 > 0 ? self->row0 - row_unknowns(self, gy_lo) : self->row0);
+
+    /* local rows, same stencil as generate_mat, with global columns for now */
+    double invh2 = (m-1)*(m-1); // for unit lenght
+    int nx = self->nx, nnz = 0;
+    int row1 = self->row0 + self->nrows;
+    int min_col = self->row0, max_col = row1 - 1;
+    for (int iy = self->gy0; iy < self->gy1; iy++) {
+        for (int ix = 0; ix < nx; ix++) {
+            int ind = ix + nx * (iy - gy_lo);
+            if (map[ind] == -1) continue;
+            self->ia[map[ind] - self->row0] = nnz;
+            int nb[5] = {
+                iy > 0 ? map[ind - nx] : -1, // south
+                ix > 0 ? map[ind - 1] : -1, // west
+                map[ind], // diagonal
+                ix < nx - 1 ? map[ind + 1] : -1, // east
+                iy < self->ny - 1 ? map[ind + nx] : -1 // north
+            };
+            for (int k = 0; k < 5; k++) {
+                if (nb[k] == -1) continue;
+                self->a[nnz] = k == 2 ? 4.0*invh2 : -invh2; /* for D=1 */
+                self->ja[nnz] = nb[k];
+                nnz++;
+                if (nb[k] < min_col) min_col = nb[k];
+                if (nb[k] > max_col) max_col = nb[k];
+            }
+        }
+    }
+    self->ia[self->nrows] = nnz;
+    free(map);
+
+    /* ghosts : columns outside of the owned rows, the columns are shifted to the local vector */
+    self->nghost_lo = self->row0 - min_col;
+    self->nghost_hi = max_col - (row1 - 1);
+    self->col0 = min_col;
+    self->interior0 = 0;
+    self->interior1 = self->nrows;
+    for (int i = 0; i < self->nrows; i++) {
+        for (int j = self->ia[i]; j < self->ia[i+1]; j++) {
+            int col = self->ja[j];
+            self->ja[j] = col - self->col0;
+            // rows using ghosts below are at the beginning of the strip, those using ghosts above at the end
+            if (col < self->row0) self->interior0 = i + 1;
+            if (col >= row1 && self->interior1 == self->nrows) self->interior1 = i;
+        }
+    }
+    if (self->interior1 < self->interior0) self->interior1 = self->interior0;
+    self->x = (double*)malloc((self->nghost_lo + self->nrows + self->nghost_hi) * sizeof(double));
+    if (self->x == NULL) {
+        printf("\n ERROR : not enough memory for the local vector of rank %d\n\n", self->rank);
+        return EXIT_FAILURE;
+    }
+
+    /* the ghosts of a neighbor are what has to be sent to it */
+    int lo = self->rank > 0 ? self->rank - 1 : MPI_PROC_NULL;
+    int hi = self->rank < self->size - 1 ? self->rank + 1 : MPI_PROC_NULL;
+    self->send_lo = self->send_hi = 0;
+    MPI_Sendrecv(&self->nghost_lo, 1, MPI_INT, lo, TAG_DOWN, &self->send_hi, 1, MPI_INT, hi, TAG_DOWN, comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(&self->nghost_hi, 1, MPI_INT, hi, TAG_UP, &self->send_lo, 1, MPI_INT, lo, TAG_UP, comm, MPI_STATUS_IGNORE);
+
+    self->matvec = dist_matvec;
+    self->close = close_dist_problem;
+    return EXIT_SUCCESS;
+}
+
+/// @brief Runs the heat evolution (progressive euler method) and the slepc solve for the minimal
+///        eigenvalue on the strips of all the ranks of MPI_COMM_WORLD, timings are printed by rank 0
+/// @param m the number of grid points for the unit lenght
+/// @param shape the shape of the membrane
+/// @param hole the hole in the grid coordinates system
+/// @return integer for error handling, the caller has to abort the other ranks on a failure
+int distributed_run(int m, pos2d shape, Rectangle hole) {
+    dist_problem dp;
+    if (init_dist_problem(&dp, m, shape, hole, MPI_COMM_WORLD)) return EXIT_FAILURE;
+
+    if (dp.rank == 0) {
+        broadcast("distributed run");
+        printf("%d ranks, about %d unknowns per rank\n", dp.size, dp.n / dp.size);
+    }
+    printf("rank %d : rows [%d, %d), ghosts below %d, above %d, interior rows %d\n",
+           dp.rank, dp.row0, dp.row0 + dp.nrows, dp.nghost_lo, dp.nghost_hi, dp.interior1 - dp.interior0);
+
+    /* dt max from the Gershgorin bound, no eigenvalue solve is needed */
+    double local_bound = 0, bound;
+    for (int i = 0; i < dp.nrows; i++) {
+        double row = 0;
+        for (csr_off j = dp.ia[i]; j < dp.ia[i+1]; j++) row += fabs(dp.a[j]);
+        if (row > local_bound) local_bound = row;
+    }
+    MPI_Allreduce(&local_bound, &bound, 1, MPI_DOUBLE, MPI_MAX, dp.comm);
+    double dt = 2.0 / (bound * DIFFUSIVITY) / DT_F;
+    int steps = (int)ceil(TOTAL_TIME / dt);
+
+    double *uk = dp.x + dp.nghost_lo;
+    double *vk = (double*)malloc(dp.nrows * sizeof(double));
+    if (vk == NULL) return EXIT_FAILURE;
+    for (int i = 0; i < dp.nrows; i++) uk[i] = INITIAL_TEMP;
+
+    MPI_Barrier(dp.comm);
+    double ti = MPI_Wtime();
+    for (int k = 0; k < steps; k++) {
+        if (dp.matvec(&dp, vk)) return EXIT_FAILURE;
+        for (int i = 0; i < dp.nrows; i++) uk[i] -= dt * DIFFUSIVITY * vk[i];
+    }
+    double tf = MPI_Wtime() - ti, t_max;
+    MPI_Reduce(&tf, &t_max, 1, MPI_DOUBLE, MPI_MAX, 0, dp.comm);
+
+    double u_max = 0, u_max_all;
+    for (int i = 0; i < dp.nrows; i++) u_max = fmax(u_max, uk[i]);
+    MPI_Reduce(&u_max, &u_max_all, 1, MPI_DOUBLE, MPI_MAX, 0, dp.comm);
+    if (dp.rank == 0) {
+        printf("-> time taken for %d distributed euler steps was %e seconds\n", steps, t_max);
+        printf("max temperature at t = %g s : %e\n", steps * dt, u_max_all);
+        vspace;
+    }
+    free(vk);
+
+    #if SOLVING_WITH_SLEPC
+    double eval;
+    if (dp.rank == 0) {
+        broadcast("solving with slepc on all ranks for minimal eigenvalue");
+    }
+    if (slepc_dist(&dp, &eval)) {
+        dp.close(&dp);
+        return EXIT_FAILURE;
+    }
+    #endif
+
+    dp.close(&dp);
+    return EXIT_SUCCESS;
+}
+
+#endif // USE_MPI
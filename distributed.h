@@ -0,0 +1,36 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "config.h"
+#include "prob.h"
+
+#if USE_MPI
+#include <mpi.h>
+
+typedef struct sDistProblem dist_problem;
+struct sDistProblem {
+    MPI_Comm comm;
+    int rank, size;
+    int m, nx, ny; // grid of the whole membrane
+    Rectangle hole; // hole in the grid coordinates system
+    int n; // global number of unknowns
+    int gy0, gy1; // this rank owns the grid rows [gy0, gy1)
+    int row0, nrows; // and so the global rows [row0, row0 + nrows) of A
+    int nghost_lo, nghost_hi; // ghost unknowns below and above the strip
+    int col0; // global index of x[0], the first ghost below
+    int send_lo, send_hi; // owned unknowns needed by the rank below and the rank above
+    int interior0, interior1; // local rows in [interior0, interior1) do not use any ghost
+    int *ia, *ja; // local CSR, columns are indices of the local vector x
+    double *a;
+    double *x; // local vector : [ghosts below | owned | ghosts above]
+    int (*matvec)(dist_problem*, double*);
+    void (*close)(dist_problem*);
+};
+
+int init_dist_problem(dist_problem *self, int m, pos2d shape, Rectangle hole, MPI_Comm comm);
+
+int distributed_run(int m, pos2d shape, Rectangle hole);
+
+#endif // USE_MPI
+
+#endif // !DISTRIBUTED_H
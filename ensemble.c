@@ -0,0 +1,89 @@
+#include "ensemble.h"
+#include "interface_primme.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/// @brief One progressive euler step for every member that did not reach t_end,
+///        the matrix is read once for the whole block with matvec_rowmajor()
+/// @param s the ensemble object
+/// @return number of members still running after the step
+int ensemble_step(ensemble *s) {
+    int bs = s->size;
+    double *u = s->u, *v = s->v;
+    double *coef = v + s->n * bs; // dt*d of each member for this step, 0 if it is done
+
+    int active = 0;
+    for (int b = 0; b < bs; b++) {
+        double dt = s->dt[b];
+        if (s->t[b] + dt > s->t_end) dt = s->t_end - s->t[b]; // last step lands on t_end
+        if (dt < 0) dt = 0;
+        coef[b] = dt * s->d[b];
+        s->t[b] += dt;
+        if (s->t[b] < s->t_end) active++;
+    }
+
+    matvec_rowmajor(u, v, &bs, NULL);
+    for (int i = 0; i < s->n; i++) {
+        for (int b = 0; b < bs; b++) {
+            u[i*bs + b] -= coef[b] * v[i*bs + b];
+        }
+    }
+    s->steps++;
+    return active;
+}
+
+/// @brief copies the temperature of one member to a contiguous vector (for gnuplot)
+/// @param b the member
+/// @param ub vector of n doubles
+void ensemble_extract(ensemble *s, int b, double *ub) {
+    for (int i = 0; i < s->n; i++) ub[i] = s->u[i*s->size + b];
+}
+
+/// @brief frees all heap allocated memory of the ensemble
+void close_ensemble(ensemble *s) {
+    free(s->u);
+    free(s->d);
+}
+
+/// @brief Initializes an ensemble of independent heat simulations on the same plate,
+///        advanced together with the progressive euler method
+/// @param self the yet uninitialized object
+/// @param n number of unknowns of the problem
+/// @param size number of members
+/// @param d diffusivity of each member
+/// @param u0 initial (uniform) temperature of each member
+/// @param lambda_max max eigenvalue (or an upper bound) of the problem matrix
+/// @param dt_f fraction of dt max used by each member, dt = 2/(lambda_max*d)/dt_f
+/// @param t_end time each member has to reach
+/// @return integer for error handling
+int init_ensemble(ensemble *self, int n, int size, double *d, double *u0, double lambda_max, double dt_f, double t_end) {
+    self->n = n;
+    self->size = size;
+    self->t_end = t_end;
+    self->steps = 0;
+
+    /* u, v and the per-member coefficients of a step share one allocation */
+    self->u = (double*)malloc((2*n + 1) * size * sizeof(double));
+    self->d = (double*)malloc(3 * size * sizeof(double));
+    if (self->u == NULL || self->d == NULL) {
+        printf("\n ERROR : not enough memory for the ensemble of %d members\n\n", size);
+        return EXIT_FAILURE;
+    }
+    self->v = self->u + n*size;
+    self->dt = self->d + size;
+    self->t = self->d + 2*size;
+
+    for (int b = 0; b < size; b++) {
+        self->d[b] = d[b];
+        self->dt[b] = 2.0 / (lambda_max * d[b]) / dt_f;
+        self->t[b] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        for (int b = 0; b < size; b++) self->u[i*size + b] = u0[b];
+    }
+
+    self->step = ensemble_step;
+    self->extract = ensemble_extract;
+    self->close = close_ensemble;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+typedef struct sEnsemble ensemble;
+struct sEnsemble {
+    int n; // unknowns of one member
+    int size; // number of members
+    double *u, *v; // row-major blocks : u[i*size + b] is the temperature of member b at point i
+    double *d, *dt, *t; // diffusivity, time step and time of each member
+    double t_end;
+    int steps;
+    int (*step)(ensemble*);
+    void (*extract)(ensemble*, int, double*);
+    void (*close)(ensemble*);
+};
+
+int init_ensemble(ensemble *self, int n, int size, double *d, double *u0, double lambda_max, double dt_f, double t_end);
+
+#endif // !ENSEMBLE_H
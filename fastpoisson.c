@@ -0,0 +1,318 @@
+#include "fastpoisson.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "time.h"
+
+typedef struct { double re, im; } cplx;
+
+/// @brief sine transform of the lines of length n : the fft of length len = 2(n+1) is done with
+///        the mixed radix fft when len only has small prime factors, else with bluestein's chirp
+///        convolution through a power of 2 fft of length m (a radix p butterfly costs p^2)
+typedef struct {
+    int n, len, m; // m = 0 when bluestein is not needed
+    cplx *w; // exp(-2 i pi t/len), or exp(-2 i pi t/m) for bluestein
+    cplx *chirp; // exp(-i pi j^2/len)
+    cplx *bhat; // fft of the conjugated chirp, wrapped around on m points
+    cplx *z, *zf, *a, *tmp; // work
+} dst_plan;
+
+static fastpoisson cached = {NULL};
+
+/// @brief mixed radix fft (decimation in time) of in[0], in[stride], ... in[(n-1)*stride] into out[0..n),
+///        w holds exp(-2 i pi t/N) for the length N of the first call, wstride = N/n
+static void fft_rec(const cplx *in, cplx *out, int n, int stride, const cplx *w, int wstride, cplx *tmp) {
+    if (n == 1) {
+        out[0] = in[0];
+        return;
+    }
+    int p = 2;
+    while (n % p) p++; // smallest prime factor
+    int m = n / p;
+    for (int r = 0; r < p; r++) fft_rec(in + r*stride, out + r*m, m, stride*p, w, wstride*p, tmp);
+
+    /* butterflies of radix p */
+    for (int k = 0; k < m; k++) {
+        for (int q = 0; q < p; q++) {
+            cplx sum = {0, 0};
+            int t = k + q*m;
+            for (int r = 0; r < p; r++) {
+                cplx a = out[r*m + k];
+                cplx tw = w[((r*t) % n) * wstride];
+                sum.re += a.re*tw.re - a.im*tw.im;
+                sum.im += a.re*tw.im + a.im*tw.re;
+            }
+            tmp[q] = sum;
+        }
+        for (int q = 0; q < p; q++) out[q*m + k] = tmp[q];
+    }
+}
+
+/// @brief fft of z[0..len) into zf[0..len)
+static void fft_plan(dst_plan *pl, cplx *z, cplx *zf) {
+    if (pl->m == 0) {
+        fft_rec(z, zf, pl->len, 1, pl->w, 1, pl->tmp);
+        return;
+    }
+    int len = pl->len, m = pl->m;
+    cplx *a = pl->a, *af = pl->a + m;
+    for (int j = 0; j < m; j++) {
+        if (j < len) {
+            a[j].re = z[j].re*pl->chirp[j].re - z[j].im*pl->chirp[j].im;
+            a[j].im = z[j].re*pl->chirp[j].im + z[j].im*pl->chirp[j].re;
+        } else {
+            a[j].re = a[j].im = 0;
+        }
+    }
+    fft_rec(a, af, m, 1, pl->w, 1, pl->tmp);
+    /* product with bhat, conjugated so that the forward fft gives the inverse one */
+    for (int j = 0; j < m; j++) {
+        double re = af[j].re*pl->bhat[j].re - af[j].im*pl->bhat[j].im;
+        double im = af[j].re*pl->bhat[j].im + af[j].im*pl->bhat[j].re;
+        af[j].re = re;
+        af[j].im = -im;
+    }
+    fft_rec(af, a, m, 1, pl->w, 1, pl->tmp);
+    for (int k = 0; k < len; k++) {
+        double re = a[k].re / m, im = -a[k].im / m;
+        zf[k].re = re*pl->chirp[k].re - im*pl->chirp[k].im;
+        zf[k].im = re*pl->chirp[k].im + im*pl->chirp[k].re;
+    }
+}
+
+/// @brief prepares the sine transform of the lines of length n
+/// @return integer for error handling
+static int init_dst_plan(dst_plan *pl, int n) {
+    int len = 2*(n+1), rest = len;
+    for (int p = 2; p <= 7; p++) while (rest % p == 0) rest /= p;
+
+    pl->n = n;
+    pl->len = len;
+    pl->m = 0;
+    if (rest > 1) {
+        pl->m = 1;
+        while (pl->m < 2*len - 1) pl->m *= 2;
+    }
+    int nw = pl->m ? pl->m : len;
+    pl->w = (cplx*)malloc((nw + 2*len + 4*nw + 8) * sizeof(cplx));
+    pl->chirp = (cplx*)malloc((len + pl->m) * sizeof(cplx));
+    if (pl->w == NULL || pl->chirp == NULL) return EXIT_FAILURE;
+    pl->z = pl->w + nw;
+    pl->zf = pl->z + len;
+    pl->a = pl->zf + len;
+    pl->tmp = pl->a + 2*nw;
+    pl->bhat = pl->chirp + len;
+
+    for (int t = 0; t < nw; t++) {
+        pl->w[t].re = cos(2*M_PI*t/nw);
+        pl->w[t].im = -sin(2*M_PI*t/nw);
+    }
+    if (pl->m) {
+        int m = pl->m;
+        for (int j = 0; j < len; j++) {
+            long long j2 = ((long long)j*j) % (2*len); // keeps the angle accurate for large j
+            pl->chirp[j].re = cos(M_PI*j2/len);
+            pl->chirp[j].im = -sin(M_PI*j2/len);
+        }
+        cplx *b = pl->a;
+        for (int j = 0; j < m; j++) b[j].re = b[j].im = 0;
+        for (int j = 0; j < len; j++) {
+            b[j].re = pl->chirp[j].re;
+            b[j].im = -pl->chirp[j].im;
+            if (j > 0) b[m-j] = b[j];
+        }
+        fft_rec(b, pl->bhat, m, 1, pl->w, 1, pl->tmp);
+    }
+    return EXIT_SUCCESS;
+}
+
+/// @brief in-place sine transform (DST-I) y_k = sum_j x_j sin(pi j k/(n+1)) of x[0], x[s], ... x[(n-1)s]
+///        through an fft of the odd extension of length 2(n+1)
+static void dst(dst_plan *pl, double *x, int s) {
+    int n = pl->n, len = pl->len;
+    cplx *z = pl->z, *zf = pl->zf;
+    z[0].re = z[0].im = z[n+1].re = z[n+1].im = 0;
+    for (int j = 1; j <= n; j++) {
+        z[j].re = x[(j-1)*s]; z[j].im = 0;
+        z[len-j].re = -x[(j-1)*s]; z[len-j].im = 0;
+    }
+    fft_plan(pl, z, zf);
+    for (int k = 1; k <= n; k++) x[(k-1)*s] = -0.5 * zf[k].im;
+}
+
+/// @brief applies the inverse of alpha*I + beta*A on the full rectangle (no hole) to the field g
+static void rectangle_inverse(fastpoisson *s, double *g) {
+    int nx = s->p->nx, ny = s->p->ny;
+    dst_plan *px = (dst_plan*)s->plans, *py = px + 1;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int iy = 0; iy < ny; iy++) dst(px, g + iy*nx, 1);
+        for (int ix = 0; ix < nx; ix++) dst(py, g + ix, nx);
+        if (pass == 0) {
+            for (int i = 0; i < nx*ny; i++) g[i] /= s->eig[i];
+        }
+    }
+}
+
+/// @brief Solves (alpha*I + beta*A) x = b : the rectangle solution is corrected by sources on the hole
+///        nodes next to the unknowns, chosen with the capacitance matrix so that the field is 0 on them
+/// @param b right hand side (n doubles)
+/// @param x solution (n doubles), can be the same vector as b
+/// @return integer for error handling
+int fastpoisson_solve(fastpoisson *s, double *b, double *x) {
+    problem *p = s->p;
+    int ng = p->nx * p->ny;
+    double *g = s->grid, *gc = s->grid + ng, *c = s->grid + 2*ng;
+
+    for (int i = 0; i < ng; i++) g[i] = (p->inds[i] != -1) ? b[p->inds[i]] : 0.0;
+    rectangle_inverse(s, g);
+
+    if (s->nb > 0) {
+        /* C c = -g on the hole boundary, with C = L L^T */
+        int nb = s->nb;
+        for (int i = 0; i < nb; i++) {
+            double sum = -g[s->bnodes[i]];
+            for (int j = 0; j < i; j++) sum -= s->cap[i*nb + j] * c[j];
+            c[i] = sum / s->cap[i*nb + i];
+        }
+        for (int i = nb-1; i >= 0; i--) {
+            double sum = c[i];
+            for (int j = i+1; j < nb; j++) sum -= s->cap[j*nb + i] * c[j];
+            c[i] = sum / s->cap[i*nb + i];
+        }
+        memset(gc, 0, ng * sizeof(double));
+        for (int i = 0; i < nb; i++) gc[s->bnodes[i]] = c[i];
+        rectangle_inverse(s, gc);
+        for (int i = 0; i < ng; i++) g[i] += gc[i];
+    }
+
+    for (int i = 0; i < ng; i++) if (p->inds[i] != -1) x[p->inds[i]] = g[i];
+    return EXIT_SUCCESS;
+}
+
+/// @brief frees the cached solver
+static void free_fastpoisson(fastpoisson *s) {
+    dst_plan *pl = (dst_plan*)s->plans;
+    if (pl != NULL) {
+        for (int i = 0; i < 2; i++) { free(pl[i].w); free(pl[i].chirp); }
+    }
+    free(s->eig); free(s->grid); free(s->plans); free(s->bnodes); free(s->cap);
+    memset(s, 0, sizeof(fastpoisson));
+}
+
+/// @brief Builds the fast solver of (alpha*I + beta*A) x = b for the 5 point operator :
+///        sine transforms on the full rectangle and a dense capacitance system for the hole
+/// @return integer for error handling
+static int build_fastpoisson(fastpoisson *s, problem *p, double alpha, double beta) {
+    int nx = p->nx, ny = p->ny, ng = nx*ny;
+    double invh2 = (p->m-1)*(p->m-1);
+
+    s->p = p;
+    s->alpha = alpha;
+    s->beta = beta;
+
+    /* hole nodes with a neighbor in the domain */
+    s->bnodes = (int*)malloc(ng * sizeof(int));
+    s->nb = 0;
+    for (int iy = 0; iy < ny; iy++) {
+        for (int ix = 0; ix < nx; ix++) {
+            int g = ix + nx*iy;
+            if (p->inds[g] != -1) continue;
+            if ((ix > 0 && p->inds[g-1] != -1) || (ix < nx-1 && p->inds[g+1] != -1) ||
+                (iy > 0 && p->inds[g-nx] != -1) || (iy < ny-1 && p->inds[g+nx] != -1)) {
+                s->bnodes[s->nb++] = g;
+            }
+        }
+    }
+
+    s->eig = (double*)malloc(ng * sizeof(double));
+    s->grid = (double*)malloc((2*ng + s->nb) * sizeof(double));
+    s->plans = calloc(2, sizeof(dst_plan));
+    s->cap = (double*)malloc((s->nb > 0 ? s->nb*s->nb : 1) * sizeof(double));
+    if (s->bnodes == NULL || s->eig == NULL || s->grid == NULL || s->plans == NULL || s->cap == NULL ||
+        init_dst_plan((dst_plan*)s->plans, nx) || init_dst_plan((dst_plan*)s->plans + 1, ny)) {
+        printf("\n ERROR : not enough memory for the fast poisson solver\n\n");
+        return EXIT_FAILURE;
+    }
+
+    /* eigenvalues, with the normalization of the two sine transforms (DST-I squared is (n+1)/2 I) */
+    for (int l = 1; l <= ny; l++) {
+        for (int k = 1; k <= nx; k++) {
+            double mu = invh2 * (4.0 - 2.0*cos(M_PI*k/(nx+1)) - 2.0*cos(M_PI*l/(ny+1)));
+            s->eig[(k-1) + nx*(l-1)] = (alpha + beta*mu) * (nx+1) * (ny+1) / 4.0;
+        }
+    }
+
+    /* capacitance matrix C_ij = G(b_i, b_j), G the inverse on the rectangle, then C = L L^T */
+    int nb = s->nb;
+    for (int j = 0; j < nb; j++) {
+        memset(s->grid, 0, ng * sizeof(double));
+        s->grid[s->bnodes[j]] = 1.0;
+        rectangle_inverse(s, s->grid);
+        for (int i = 0; i < nb; i++) s->cap[i*nb + j] = s->grid[s->bnodes[i]];
+    }
+    for (int j = 0; j < nb; j++) {
+        double d = s->cap[j*nb + j];
+        for (int k = 0; k < j; k++) d -= s->cap[j*nb + k] * s->cap[j*nb + k];
+        if (d <= 0) {
+            printf("\n ERROR : capacitance matrix is not positive definite\n\n");
+            return EXIT_FAILURE;
+        }
+        d = sqrt(d);
+        s->cap[j*nb + j] = d;
+        for (int i = j+1; i < nb; i++) {
+            double sum = s->cap[i*nb + j];
+            for (int k = 0; k < j; k++) sum -= s->cap[i*nb + k] * s->cap[j*nb + k];
+            s->cap[i*nb + j] = sum / d;
+        }
+    }
+
+    s->solve = fastpoisson_solve;
+    return EXIT_SUCCESS;
+}
+
+/// @brief Gives the fast solver of (alpha*I + beta*A) x = b, A being the 5 point operator of the problem.
+///        The last one is cached : building it costs one pair of sine transforms per hole boundary node.
+/// @param s the problem object, its matrix has to be generated
+/// @return the solver (owned by the cache), NULL on failure
+fastpoisson *fastpoisson_get(problem *s, double alpha, double beta) {
+    double ti, tf;
+    if (cached.p == s && cached.alpha == alpha && cached.beta == beta) return &cached;
+    if (s->b != NULL) {
+        printf("\n ERROR : the fast poisson solver only supports the 5 point stencil\n\n");
+        return NULL;
+    }
+    free_fastpoisson(&cached);
+    tic(mytimer_wall, ti);
+    if (build_fastpoisson(&cached, s, alpha, beta)) {
+        free_fastpoisson(&cached);
+        return NULL;
+    }
+    tf = mytimer_wall();
+    printf("-> time taken for the fast poisson solver of %g I + %g A was %e seconds (%d capacitance nodes)\n",
+           alpha, beta, tf-ti, cached.nb);
+    return &cached;
+}
+
+/// @brief drops the cached solver of the problem (called when the problem is freed)
+void fastpoisson_forget(problem *s) {
+    if (cached.p == s) free_fastpoisson(&cached);
+}
+
+/// @brief primme preconditioner vy = A^-1 vx with the fast poisson solver,
+///        primme->preconditioner has to point to the problem object. Without a solver for the grid
+///        (not enough memory, hole not supported) y = x and the solve is reported as failed by primme_lowest()
+void precond_fastpoisson(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    problem *s = (problem*)primme->preconditioner;
+    fastpoisson *f = fastpoisson_get(s, 0.0, 1.0);
+    double *x = (double*)vx, *y = (double*)vy;
+    if (f == NULL) {
+        primme_operator_failed();
+        memcpy(y, x, (size_t)(*blockSize) * s->n * sizeof(double));
+        return;
+    }
+    for (int b = 0; b < *blockSize; b++) f->solve(f, x + b*s->n, y + b*s->n);
+}
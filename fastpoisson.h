@@ -0,0 +1,26 @@
+#ifndef FASTPOISSON_H
+#define FASTPOISSON_H
+
+#include "prob.h"
+#include "interface_primme.h"
+
+typedef struct sFastPoisson fastpoisson;
+struct sFastPoisson {
+    problem *p;
+    double alpha, beta; // solves (alpha*I + beta*A) x = b
+    double *eig; // eigenvalues of alpha*I + beta*A on the full rectangle, in the sine basis
+    double *grid; // work : a field on the full nx x ny rectangle
+    void *plans; // sine transforms of the x and y lines, with their work space
+    int nb; // number of hole nodes next to an unknown
+    int *bnodes; // their index in the rectangle
+    double *cap; // cholesky factor of the capacitance matrix (nb x nb, dense)
+    int (*solve)(fastpoisson*, double*, double*);
+};
+
+fastpoisson *fastpoisson_get(problem *s, double alpha, double beta);
+
+void fastpoisson_forget(problem *s);
+
+void precond_fastpoisson(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+#endif // !FASTPOISSON_H
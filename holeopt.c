@@ -0,0 +1,155 @@
+#include "holeopt.h"
+#include "interface_primme.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <math.h>
+#include "config.h"
+
+#define HOLEOPT_GAIN 1e-9 // relative increase of lambda for a move to be tried and accepted, above the solver tolerance
+
+/// @brief Shape derivative of the minimal eigenvalue with respect to the edges of the hole (Hadamard formula) :
+/// an edge moved by dn outwards (the hole grows) changes lambda by dn times the integral of (du/dn)^2 along the
+/// edge, u normalized in L2. du/dn is taken from the unknown next to the edge (u = 0 on the edge), the corners
+/// have half weight (trapezoidal rule)
+/// @param s the problem (its inds array has to be filled by generate_mat)
+/// @param u eigenvector of the minimal eigenvalue
+/// @param dedge d lambda / dn of the left, right, bottom and upper edges of the hole (units of the membrane)
+void hole_sensitivity(problem *s, double *u, double dedge[4]) {
+    Rectangle *is = &s->i_s;
+    double h = 1.0 / (s->m - 1);
+    double norm2 = 0;
+    for (int i = 0; i < s->n; i++) norm2 += u[i] * u[i];
+
+    /* neighbor of the edge and direction along it, for the left, right, bottom and upper edges */
+    int x0[4] = {is->x[0] - 1, is->x[1] + 1, is->x[0], is->x[0]};
+    int y0[4] = {is->y[0], is->y[0], is->y[0] - 1, is->y[1] + 1};
+    int len[4] = {s->ny_is, s->ny_is, s->nx_is, s->nx_is};
+    for (int e = 0; e < 4; e++) {
+        int dx = e < 2 ? 0 : 1, dy = e < 2 ? 1 : 0;
+        double sum = 0;
+        for (int k = 0; k < len[e]; k++) {
+            double v = u[s->inds[(x0[e] + k*dx) + s->nx * (y0[e] + k*dy)]];
+            sum += (k == 0 || k == len[e] - 1) ? 0.5 * v * v : v * v;
+        }
+        /* (v/h)^2 h per point, u/(h sqrt(norm2)) has a unit L2 norm on the membrane */
+        dedge[e] = sum / (h * h * h * norm2);
+    }
+}
+
+/// @brief copies a field to the grid of another hole of the same size, the points that were in the old hole start at 0
+static void transfer(problem *from, double *u, problem *to, double *v) {
+    for (int k = 0; k < to->nx * to->ny; k++) {
+        if (to->inds[k] == -1) continue;
+        v[to->inds[k]] = (from->inds[k] == -1) ? 0 : u[from->inds[k]];
+    }
+}
+
+/// @brief generates the problem of a hole and solves for its minimal eigenvalue
+/// @param prev problem of the previous hole and its eigenvector, the initial guess of the solve (NULL for none)
+/// @return integer for error handling
+static int solve_hole(problem *s, int m, pos2d shape, Rectangle hole, problem *prev, double *uprev,
+                      double **u, double *lambda, holeopt_result *res) {
+    solver_stats st;
+    if (init_problem_grid(s, m, shape, hole)) return EXIT_FAILURE;
+    s->generate_mat(s);
+    *u = problem_vector(s, "evec");
+    if (*u == NULL) {
+        printf("\n ERROR : not enough memory for the eigenvector of the hole optimizer\n\n");
+        return EXIT_FAILURE;
+    }
+
+    if (init_primme(s->n, s->ia, s->ja, s->a)) return EXIT_FAILURE;
+    #if KERNEL_LIBRARY && KERNEL_VARIANT == KERNEL_STENCIL
+    kernels_grid(s);
+    #endif
+    #if STENCIL_9PT
+    if (init_primme_generalized(s)) return EXIT_FAILURE;
+    #elif PRIMME_SHIFT_INVERT
+    if (init_primme_shift_invert(s, SHIFT_INVERT_SIGMA)) return EXIT_FAILURE;
+    #elif FAST_POISSON_PRECOND
+    if (init_primme_precond(s)) return EXIT_FAILURE;
+    #endif
+
+    if (prev != NULL) transfer(prev, uprev, s, *u);
+    if (primme_lowest(lambda, *u, prev != NULL)) return EXIT_FAILURE;
+    primme_last_stats(&st);
+    res->solves++;
+    res->matvecs += st.matvecs;
+    return EXIT_SUCCESS;
+}
+
+/// @brief Moves a hole of fixed size to a local maximum of the minimal eigenvalue (fundamental frequency). Each step
+/// follows the shape derivative of lambda from the current eigenvector (hole_sensitivity) : the hole is translated
+/// by HOLEOPT_STEP grid cells along the gradient, snapped to the grid, the move is kept if the solve confirms an
+/// increase, otherwise the step is halved. With a step of one cell, the single axis moves with a predicted increase
+/// are also tried before stopping. Each solve starts from the eigenvector of the current hole.
+/// @param shape the shape of the membrane
+/// @param sub_shape the initial hole (units of the membrane)
+/// @param m number of grid points for the unit lenght
+/// @param res the initial and optimized holes (grid indices) and eigenvalues
+/// @return integer for error handling
+int holeopt(pos2d shape, Rectangle sub_shape, int m, holeopt_result *res) {
+    problem p[2];
+    double *u[2];
+    int cur = 0, step = HOLEOPT_STEP;
+    double h = 1.0 / (m - 1), dedge[4];
+
+    res->solves = 0;
+    res->moves = 0;
+    res->matvecs = 0;
+    res->hole0 = get_sub_shape_indices(&sub_shape, m);
+    res->hole = res->hole0;
+    if (solve_hole(&p[cur], m, shape, res->hole, NULL, NULL, &u[cur], &res->lambda0, res)) return EXIT_FAILURE;
+    res->lambda = res->lambda0;
+    printf("hole optimizer : [%4d, %4d] x [%4d, %4d]   lambda = %.12e\n",
+           res->hole.x[0], res->hole.x[1], res->hole.y[0], res->hole.y[1], res->lambda);
+
+    while (step > 0 && res->solves < HOLEOPT_MAX_SOLVES) {
+        hole_sensitivity(&p[cur], u[cur], dedge);
+        double gx = dedge[1] - dedge[0], gy = dedge[3] - dedge[2]; // translation : one edge grows, the other shrinks
+        double gmax = fmax(fabs(gx), fabs(gy));
+        if (gmax == 0) {step = 0; break;}
+
+        /* candidate moves (grid cells) : along the gradient, then the axis moves once the step is one cell */
+        int moves[3][2] = {{(int)lround(step * gx / gmax), (int)lround(step * gy / gmax)},
+                           {gx > 0 ? 1 : -1, 0}, {0, gy > 0 ? 1 : -1}};
+        int tries = (step == 1) ? 3 : 1;
+        int accepted = 0;
+        for (int t = 0; t < tries && !accepted && res->solves < HOLEOPT_MAX_SOLVES; t++) {
+            int dx = moves[t][0], dy = moves[t][1];
+            if ((t > 0 && dx == moves[0][0] && dy == moves[0][1]) || (dx * gx + dy * gy) * h <= HOLEOPT_GAIN * res->lambda) continue;
+            Rectangle hole = res->hole;
+            hole.x[0] += dx; hole.x[1] += dx;
+            hole.y[0] += dy; hole.y[1] += dy;
+            /* the hole stays strictly inside the membrane */
+            if (hole.x[0] < 1 || hole.x[1] > p[cur].nx - 2 || hole.y[0] < 1 || hole.y[1] > p[cur].ny - 2) continue;
+
+            int next = 1 - cur;
+            double lambda;
+            if (solve_hole(&p[next], m, shape, hole, &p[cur], u[cur], &u[next], &lambda, res)) return EXIT_FAILURE;
+            printf("hole optimizer : [%4d, %4d] x [%4d, %4d]   lambda = %.12e   predicted %+e   %s\n",
+                   hole.x[0], hole.x[1], hole.y[0], hole.y[1], lambda, (dx * gx + dy * gy) * h,
+                   lambda > res->lambda * (1 + HOLEOPT_GAIN) ? "accepted" : "rejected");
+            if (lambda > res->lambda * (1 + HOLEOPT_GAIN)) {
+                accepted = 1;
+                res->lambda = lambda;
+                res->hole = hole;
+                res->moves++;
+                problem_vector_free(&p[cur], u[cur]);
+                p[cur].close(&p[cur]);
+                cur = next;
+            } else {
+                problem_vector_free(&p[next], u[next]);
+                p[next].close(&p[next]);
+            }
+        }
+        if (!accepted) step /= 2;
+    }
+    hole_sensitivity(&p[cur], u[cur], dedge);
+    res->gradient[0] = dedge[1] - dedge[0];
+    res->gradient[1] = dedge[3] - dedge[2];
+    if (step > 0) printf("hole optimizer : stopped after %d solves, the hole may not be at a local optimum\n", res->solves);
+    problem_vector_free(&p[cur], u[cur]);
+    p[cur].close(&p[cur]);
+    return EXIT_SUCCESS;
+}
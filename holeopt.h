@@ -0,0 +1,21 @@
+#ifndef HOLEOPT_H
+#define HOLEOPT_H
+
+#include "prob.h"
+
+typedef struct {
+    int solves; // minimal eigenvalue solves, the initial one included
+    int moves; // accepted moves of the hole
+    int matvecs; // of all the solves
+    double lambda0; // minimal eigenvalue with the initial hole
+    double lambda; // minimal eigenvalue with the optimized hole
+    Rectangle hole0; // initial hole (grid indices)
+    Rectangle hole; // optimized hole (grid indices), for init_problem_grid
+    double gradient[2]; // d lambda / dx and d lambda / dy of a translation of the hole at the optimum
+} holeopt_result;
+
+void hole_sensitivity(problem *s, double *u, double dedge[4]);
+
+int holeopt(pos2d shape, Rectangle sub_shape, int m, holeopt_result *res);
+
+#endif // !HOLEOPT_H
@@ -1,10 +1,31 @@
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "interface_primme.h"
 #include "config.h"
 #include "time.h"
+#include "cholesky.h"
+#include "fastpoisson.h"
+#include "spectral.h"
+#include "kernels.h"
+#include "storage.h"
 
 static double *a;
-static int n, *ia, *ja;
+static csr_off *ia;
+static int n, *ja;
+static problem *prob; // needed for the cholesky factorization of the shift-invert operator and the preconditioner
+static double sigma;
+static double *gwork; // work vectors of the generalized operator (2n doubles)
+static float *af; // single precision copy of a for the mixed precision solve
+static solver_stats last_stats; // statistics of the last minimal eigenvalue solve (primme_lowest or primme_mixed)
+static int operator_failed; // set by an operator given to primme that could not be applied
+
+/// @brief to be called by an operator given to primme (matvec or preconditioner) that cannot be applied,
+/// primme 1.2.2 has no error argument for them : the solve is then reported as failed by primme_lowest()
+void primme_operator_failed(void)
+{
+    operator_failed = 1;
+}
 
 /// @brief to initialize static varibles for primme
 /// @param primme_n number of unknowns in the system
@@ -12,15 +33,200 @@ static int n, *ia, *ja;
 /// @param primme_ja array 'ja' of matrix A
 /// @param primme_a array 'a' of matrix A
 /// @return integer for error handling
-int init_primme(int primme_n, int *primme_ia, int *primme_ja, double *primme_a) 
+int init_primme(int primme_n, csr_off *primme_ia, int *primme_ja, double *primme_a) 
 {
     n = primme_n;
     a = primme_a;
     ja = primme_ja;
     ia = primme_ia;
+    #if KERNEL_LIBRARY
+    return kernels_init(primme_n, primme_ia, primme_ja, primme_a);
+    #endif
     return EXIT_SUCCESS;
 }
 
+/// @brief to initialize the shift-invert operator (A - shift*I)^-1 used by primme when PRIMME_SHIFT_INVERT is set
+/// @param s the problem object holding the matrix
+/// @param shift has to stay below the minimal eigenvalue for A - shift*I to be positive definite
+/// @return integer for error handling
+int init_primme_shift_invert(problem *s, double shift)
+{
+    prob = s;
+    sigma = shift;
+    return cholesky_get(prob, prob->a, -sigma, 1.0) == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/// @brief to initialize the fast poisson preconditioner A^-1 used by primme when FAST_POISSON_PRECOND is set
+/// @param s the problem object holding the matrix
+/// @return integer for error handling
+int init_primme_precond(problem *s)
+{
+    prob = s;
+    return fastpoisson_get(prob, 0.0, 1.0) == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/// @brief to initialize the symmetric operator L^-1 A L^-T of the generalized problem A u = lambda B u
+/// given by the 9 point stencil, B = L L^T being factored once with the cached cholesky factorization
+/// @param s the problem object holding A (s->a) and B (s->b)
+/// @return integer for error handling
+int init_primme_generalized(problem *s)
+{
+    prob = s;
+    free(gwork);
+    gwork = (double*)malloc(2 * (size_t)s->n * sizeof(double));
+    if (gwork == NULL) {
+        printf("\n ERROR : not enough memory for the generalized operator\n\n");
+        return EXIT_FAILURE;
+    }
+    return cholesky_get(prob, prob->b, 0.0, 1.0) == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/// @brief Calculate vy = L^-1 A L^-T vx with B = L L^T : same eigenvalues as A u = lambda B u,
+/// the eigenvectors are u = L^-T v (see generalized_eigvec())
+/// @param vx input vector(s)
+/// @param vy output vector(s)
+/// @param blockSize number of vectors
+/// @param primme unused
+void matvec_generalized(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    double *x = (double*)vx, *y = (double*)vy, *w = gwork + n;
+    int one = 1;
+    cholesky *f = cholesky_get(prob, prob->b, 0.0, 1.0);
+    for (size_t b = 0; b < (size_t)(*blockSize)*n; b += n) {
+        memcpy(gwork, x+b, n * sizeof(double));
+        f->ltsolve(f, gwork, w);
+        matvec_primme(w, gwork, &one, NULL);
+        f->lsolve(f, gwork, y+b);
+    }
+}
+
+/// @brief gives the eigenvector u = L^-T v of A u = lambda B u from the one of L^-1 A L^-T, normalized
+void generalized_eigvec(double *v)
+{
+    double norm = 0;
+    cholesky *f = cholesky_get(prob, prob->b, 0.0, 1.0);
+    memcpy(gwork, v, n * sizeof(double));
+    f->ltsolve(f, gwork, v);
+    for (int i = 0; i < n; i++) norm += v[i]*v[i];
+    norm = sqrt(norm);
+    for (int i = 0; i < n; i++) v[i] /= norm;
+}
+
+#if STENCIL_9PT
+/// @brief gives the vector v = L^T P u of the operator L^-1 A L^-T from an approximation u of the
+/// eigenvector of A u = lambda B u (used for initial guesses), in place
+static void generalized_guess(double *u)
+{
+    cholesky *f = cholesky_get(prob, prob->b, 0.0, 1.0);
+    int *perm = f->sym->perm, *lp = f->sym->lp;
+    for (int k = 0; k < n; k++) gwork[k] = u[perm[k]];
+    for (int j = 0; j < n; j++) {
+        double sum = 0;
+        for (int p = lp[j]; p < lp[j+1]; p++) sum += f->lx[p] * gwork[f->li[p]];
+        u[j] = sum;
+    }
+}
+#endif
+
+/// @brief Calculate vy = B^-1 A vx, the operator of the heat equation B du/dt = -D A u
+/// (vy = A vx when there is no mass matrix, with the 5 point stencil)
+/// @param vx input vector(s)
+/// @param vy output vector(s)
+/// @param blockSize number of vectors
+/// @param primme unused
+void matvec_operator(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    if (prob == NULL || prob->b == NULL) {
+        matvec_primme(vx, vy, blockSize, primme);
+        return;
+    }
+    double *x = (double*)vx, *y = (double*)vy;
+    int one = 1;
+    cholesky *f = cholesky_get(prob, prob->b, 0.0, 1.0);
+    for (size_t b = 0; b < (size_t)(*blockSize)*n; b += n) {
+        matvec_primme(x+b, gwork, &one, NULL);
+        f->solve(f, gwork, y+b);
+    }
+}
+
+/// @brief to initialize the single precision copy of the matrix used by matvec_float()
+/// @param s the problem object holding the matrix given to init_primme()
+/// @return integer for error handling
+int init_primme_float(problem *s)
+{
+    prob = s;
+    free(af);
+    af = (float*)malloc(ia[n] * sizeof(float));
+    if (af == NULL) {
+        printf("\n ERROR : not enough memory for the single precision matrix\n\n");
+        return EXIT_FAILURE;
+    }
+    for (csr_off j = 0; j < ia[n]; j++) af[j] = (float)a[j];
+    return EXIT_SUCCESS;
+}
+
+/// @brief Calculate vy = A*vx with the values of A read in single precision :
+/// 4 bytes per non-zero element instead of 8 for the values, the sums are kept in double
+/// @param vx input vector(s)
+/// @param vy output vector(s)
+/// @param blockSize number of vectors
+/// @param primme unused
+void matvec_float(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    double *x = (double*)vx, *y = (double*)vy;
+    for (size_t b = 0; b < (size_t)(*blockSize)*n; b += n) {
+        for (int i = 0; i < n; i++) {
+            double sum = 0;
+            for (csr_off j = ia[i]; j < ia[i + 1]; j++) sum += af[j] * x[b+ja[j]];
+            y[b+i] = sum;
+        }
+    }
+}
+
+/// @brief Calculate vy = (A - sigma*I)^-1 vx with the cached cholesky factorization.
+/// The largest eigenvalues theta of this operator give the eigenvalues sigma + 1/theta of A closest to sigma
+/// @param vx input vector(s)
+/// @param vy output vector(s)
+/// @param blockSize number of vectors
+/// @param primme unused
+void matvec_shift_invert(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    double *x = (double*)vx, *y = (double*)vy;
+    cholesky *f = cholesky_get(prob, prob->a, -sigma, 1.0);
+    if (f == NULL) {
+        primme_operator_failed();
+        memset(y, 0, (size_t)(*blockSize) * n * sizeof(double));
+        return;
+    }
+    for (size_t b = 0; b < (size_t)(*blockSize)*n; b += n) f->solve(f, x+b, y+b);
+}
+
+#if LARGE_GRID
+/// @brief vy = A*vx for the file-backed matrix of LARGE_GRID : the rows are read once for the whole block of
+/// vectors, by blocks of STREAM_ROWS rows, the read-ahead of the next block being asked before the current one
+static void matvec_stream(const double *x, double *y, int bs)
+{
+    for (int r0 = 0; r0 < n; r0 += STREAM_ROWS) {
+        int r1 = (r0 + STREAM_ROWS < n) ? r0 + STREAM_ROWS : n;
+        if (r1 < n) {
+            int r2 = (r1 + STREAM_ROWS < n) ? r1 + STREAM_ROWS : n;
+            csr_off len = ia[r2] - ia[r1];
+            storage_prefetch(ia + r1, (r2 - r1 + 1) * sizeof(csr_off));
+            storage_prefetch(ja + ia[r1], len * sizeof(int));
+            storage_prefetch(a + ia[r1], len * sizeof(double));
+        }
+        for (int i = r0; i < r1; i++) {
+            for (int b = 0; b < bs; b++) {
+                const double *xb = x + (size_t)b*n;
+                double sum = 0;
+                for (csr_off j = ia[i]; j < ia[i + 1]; j++) sum += a[j] * xb[ja[j]];
+                y[(size_t)b*n + i] = sum;
+            }
+        }
+    }
+}
+#endif
+
 /// @brief Calculate the matrix-vector product vy = A*vx.
 /// The A matrix has to be stored beforehand in static variables (n,ia,ja,a) corresponding to CSR format
 /// @param vx input vector(s)
@@ -30,26 +236,70 @@ int init_primme(int primme_n, int *primme_ia, int *primme_ja, double *primme_a)
 /// @note primme can be set to NULL
 void matvec_primme(void *vx, void *vy, int *blockSize, primme_params *primme)
 {
-    int i, j, b;
+    #if LARGE_GRID
+    matvec_stream((const double*)vx, (double*)vy, *blockSize);
+    return;
+    #elif KERNEL_LIBRARY
+    kernel_matvec(vx, vy, blockSize, primme);
+    return;
+    #endif
+    int i;
+    size_t b;
     double *x = (double*)vx, *y=(double*)vy;
 
-    for(b = 0; b < (*blockSize)*n; b+=n)
+    for(b = 0; b < (size_t)(*blockSize)*n; b+=n)
         for(i = 0; i < n; i++){
             y[b+i] = 0;
-            for (j = ia[i]; j < ia[i + 1]; j++)
+            for (csr_off j = ia[i]; j < ia[i + 1]; j++)
                 y[b+i] += a[j] * x[b+ja[j]];
         }
 } 
 
+/// @brief rows of the row-major block product for the vectors b0 to b0+nb-1,
+/// called with a constant nb so that the sums are unrolled and kept in registers
+static inline void matvec_rowmajor_part(const double *x, double *y, int bs, int b0, const int nb)
+{
+    double acc[16];
+    for (int i = 0; i < n; i++) {
+        for (int b = 0; b < nb; b++) acc[b] = 0;
+        for (csr_off j = ia[i]; j < ia[i + 1]; j++) {
+            double aj = a[j];
+            const double *xj = x + (size_t)ja[j]*bs + b0;
+            for (int b = 0; b < nb; b++) acc[b] += aj * xj[b];
+        }
+        for (int b = 0; b < nb; b++) y[(size_t)i*bs + b0 + b] = acc[b];
+    }
+}
 
-/// @brief Calculate the lowest and highest eigen value of the matrix A of dimenssions primme_n x primme_n.
-/// Stored in the CSR format with the help of primme_ia, primme_ja, primme_a vectors
-/// @param min_evals minimal eigen value
-/// @param min_evecs eigen vector from minimal eigen value
-/// @param max_evals maximal eigen value
-/// @param max_evecs eigen vector from maximal eigen value
+/// @brief Calculate the matrix-vector product vy = A*vx for a row-major block of vectors :
+/// x[i*blockSize + b] is the i-th element of the b-th vector.
+/// Each row of A is read once for 16, 8, 4, 2 or 1 vectors of the block at a time.
+/// @param vx input vectors
+/// @param vy output vectors from A*vx
+/// @param blockSize number of vectors
+/// @param primme unused, kept for the same signature as matvec_primme
+void matvec_rowmajor(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    int bs = *blockSize, b0 = 0;
+    const double *x = (const double*)vx;
+    double *y = (double*)vy;
+
+    for (; b0 + 16 <= bs; b0 += 16) matvec_rowmajor_part(x, y, bs, b0, 16);
+    if (b0 + 8 <= bs) { matvec_rowmajor_part(x, y, bs, b0, 8); b0 += 8; }
+    if (b0 + 4 <= bs) { matvec_rowmajor_part(x, y, bs, b0, 4); b0 += 4; }
+    if (b0 + 2 <= bs) { matvec_rowmajor_part(x, y, bs, b0, 2); b0 += 2; }
+    if (b0 < bs) matvec_rowmajor_part(x, y, bs, b0, 1);
+}
+
+
+/// @brief Calculate the lowest eigen value of the matrix given to init_primme()
+/// (of the generalized problem with the 9 point stencil, with the operator chosen in config.h)
+/// @param evals minimal eigen value
+/// @param evecs eigen vector from minimal eigen value, holds the initial guess on entry if initSize is 1
+/// @param initSize number of initial guesses in evecs (0 or 1), a guess close to the eigenvector
+///        (from a coarser grid for instance) saves most of the iterations
 /// @return integer for error handling
-int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_evecs)
+int primme_lowest(double *evals, double *evecs, int initSize)
 {
     /*  note : compared to the original version of this program,
         primme.numEvals = nev has disappeared since primme_largest and primme_lowest already asks for one eigenvalue 
@@ -68,9 +318,23 @@ int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_
     /* Min eigenvalue */
     primme_params primme;
     primme_initialize (&primme);
+    #if STENCIL_9PT
+    primme.matrixMatvec = matvec_generalized;
+    primme.target = primme_smallest;
+    #elif PRIMME_SHIFT_INVERT
+    primme.matrixMatvec = matvec_shift_invert;
+    primme.target = primme_largest; // 1/(lambda_min - sigma) is the largest eigenvalue of (A - sigma I)^-1
+    #else
     primme.matrixMatvec = matvec_primme; 
     primme.target = primme_smallest;
+    #if FAST_POISSON_PRECOND
+    primme.applyPreconditioner = precond_fastpoisson;
+    primme.preconditioner = prob;
+    primme.correctionParams.precondition = 1;
+    #endif
+    #endif
     primme.n = n;
+    primme.initSize = initSize; // the initial guess is read from evecs
     primme.printLevel = 0; // we want to handle the results output ourselves
     if((err = primme_set_method (DEFAULT_MIN_TIME, &primme))) {
         printf("\nPRIMME: erreur N %d dans le choix de la methode \n    (voir 'Error Codes' dans le guide d'utilisateur)\n",err);
@@ -83,22 +347,241 @@ int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_
     broadcast("primme results")
     #endif /* PRIMME_PRINT */
 
+    #if STENCIL_9PT
+    if (initSize > 0) generalized_guess(evecs);
+    #endif
+
     tic(mytimer_wall, ti);
-    if((err = dprimme (min_evals, min_evecs, resn, &primme))) {
+    operator_failed = 0;
+    if((err = dprimme (evals, evecs, resn, &primme))) {
         printf("\nPRIMME: erreur N %d dans le calcul des valeurs propres \n    (voir 'Error Codes' dans le guide d'utilisateur)\n",err);
         return EXIT_FAILURE;
     }
+    if (operator_failed) {
+        printf("\n ERROR : the operator or the preconditioner of primme could not be applied\n\n");
+        primme_Free (&primme); free(resn);
+        return EXIT_FAILURE;
+    }
     tac(mytimer_wall, tf, "primme to solve for mininal eigenvalue");
+    last_stats.iterations = primme.stats.numOuterIterations;
+    last_stats.matvecs = primme.stats.numMatvecs;
+    last_stats.preconds = primme.stats.numPreconds;
+
+    #if STENCIL_9PT
+    generalized_eigvec(evecs);
+    #elif PRIMME_SHIFT_INVERT
+    printf("shift-invert : %d matvecs, largest eigenvalue of (A - %g I)^-1 : %e\n", primme.stats.numMatvecs, sigma, evals[0]);
+    evals[0] = sigma + 1.0 / evals[0];
+    resn[0] = calc_res(prob, evecs, evals[0]); // the residual of the inverse does not bound the one of A
+    #endif
+
+    #if FAST_POISSON_PRECOND && !PRIMME_SHIFT_INVERT && !STENCIL_9PT
+    printf("fast poisson preconditioner : %d matvecs, %d preconditioner applications\n",
+           primme.stats.numMatvecs, primme.stats.numPreconds);
+    #endif
+
+    printf("Minimal eigen value: %e, error : %e\n", evals[0], resn[0]);
 
-    printf("Minimal eigen value: %e, error : %e\n", min_evals[0], resn[0]);
+    primme_Free (&primme); free(resn);
+    return EXIT_SUCCESS;
+}
 
-    primme_Free (&primme);
+/// @brief projects x on the orthogonal of u (unit norm), in place
+static void project(double *x, const double *u)
+{
+    double d = 0;
+    for (int i = 0; i < n; i++) d += u[i] * x[i];
+    for (int i = 0; i < n; i++) x[i] -= d * u[i];
+}
 
+/// @brief Solves the correction equation P (A - theta I) P t = -r (P = I - u u^T, t orthogonal to u) of the
+/// eigenpair (theta, u) by conjugate gradients, down to tol relative to ||r||
+/// @param mv matvec of A : matvec_float(), or matvec_primme() once the single precision values stall the refinement
+/// @param u eigenvector approximation of unit norm
+/// @param r residual A u - theta u, orthogonal to u when theta is the rayleigh quotient
+/// @param t correction
+/// @param w work vectors (3 n)
+/// @return number of matvecs
+static int correction_cg(void (*mv)(void*, void*, int*, primme_params*), double *u, double theta, double *r,
+                         double *t, double *w, double tol, int maxit)
+{
+    double *res = w, *p = w + n, *q = w + 2*(size_t)n;
+    int one = 1, k;
+    double rho = 0, rho0, beta = 0;
+    for (int i = 0; i < n; i++) {
+        t[i] = 0;
+        res[i] = -r[i];
+        p[i] = 0;
+        rho += res[i] * res[i];
+    }
+    rho0 = rho;
+    for (k = 0; k < maxit && rho > tol * tol * rho0; k++) {
+        for (int i = 0; i < n; i++) p[i] = res[i] + beta * p[i];
+        mv(p, q, &one, NULL);
+        for (int i = 0; i < n; i++) q[i] -= theta * p[i];
+        project(q, u);
+        double pq = 0;
+        for (int i = 0; i < n; i++) pq += p[i] * q[i];
+        if (pq <= 0) break; // theta is not below the rest of the spectrum, the operator is not definite
+        double alpha = rho / pq, rho1 = 0;
+        for (int i = 0; i < n; i++) {
+            t[i] += alpha * p[i];
+            res[i] -= alpha * q[i];
+            rho1 += res[i] * res[i];
+        }
+        beta = rho1 / rho;
+        rho = rho1;
+    }
+    return k;
+}
 
+/// @brief Mixed precision solve of the lowest eigen value : primme runs with matvec_float() down to
+/// MIXED_FLOAT_EPS, the eigenpair is then refined by Jacobi-Davidson steps : the rayleigh quotient and the
+/// residual are computed in double (one double matvec per step), the correction equations are solved by
+/// conjugate gradients with matvec_float(), so that the bulk of the matvecs stays in single precision.
+/// The pair is accepted with the tolerance of the all double solve : ||A u - lambda u||/||u|| below
+/// primme.eps * ||A|| (gershgorin), the correction equations go to double precision if a step does not
+/// halve the residual (init_primme_float() has to be called beforehand)
+/// @param evals minimal eigen value
+/// @param evecs eigen vector from minimal eigen value
+/// @return integer for error handling
+/// @note primme 1.2.2 has no single precision solver : the basis stays in double,
+///       only the matrix is read in single precision
+int primme_mixed(double *evals, double *evecs)
+{
+    double ti, tf;
+    int err, one = 1;
+    double *resn = (double*)malloc(sizeof(double));
+    double *w = (double*)malloc(5 * (size_t)n * sizeof(double)); // A u, correction, work vectors of correction_cg
+    if (resn == NULL || w == NULL) {
+        printf("\n ERROR : not enough memory for the mixed precision solve\n\n");
+        return EXIT_FAILURE;
+    }
+    double *au = w, *t = w + n;
+
+    primme_params primme;
+    primme_initialize (&primme);
+    double eps = primme.eps; // default tolerance, the one of the all double solve of primme_lowest()
+    primme.matrixMatvec = matvec_float;
+    primme.target = primme_smallest;
+    primme.n = n;
+    primme.eps = MIXED_FLOAT_EPS; // single precision values, no need to go further
+    primme.printLevel = 0;
+    if((err = primme_set_method (DEFAULT_MIN_TIME, &primme))) {
+        printf("\nPRIMME: erreur N %d dans le choix de la methode \n    (voir 'Error Codes' dans le guide d'utilisateur)\n",err);
+        return 1;
+    }
+    tic(mytimer_wall, ti);
+    if((err = dprimme (evals, evecs, resn, &primme))) {
+        printf("\nPRIMME: erreur N %d dans le calcul des valeurs propres \n    (voir 'Error Codes' dans le guide d'utilisateur)\n",err);
+        return EXIT_FAILURE;
+    }
+    tac(mytimer_wall, tf, "primme with the single precision matvec");
+    int float_matvecs = primme.stats.numMatvecs;
+    int float_iterations = primme.stats.numOuterIterations;
+    printf("single precision : %d matvecs, eigen value : %e, error : %e\n", float_matvecs, evals[0], resn[0]);
+    primme_Free (&primme); free(resn);
+
+    /* double precision refinement */
+    double res = 0, prev = 0, accept = eps * gershgorin_max(prob);
+    void (*mv)(void*, void*, int*, primme_params*) = matvec_float;
+    double norm = 0;
+    for (int i = 0; i < n; i++) norm += evecs[i]*evecs[i];
+    for (int i = 0; i < n; i++) evecs[i] /= sqrt(norm);
+    int double_matvecs = 0, cg_matvecs = 0, step;
+    int double_steps = 0; // correction solves with matvec_primme()
+    tic(mytimer_wall, ti);
+    for (step = 0; ; step++) {
+        matvec_primme(evecs, au, &one, NULL);
+        double_matvecs++;
+        double theta = 0;
+        for (int i = 0; i < n; i++) theta += evecs[i] * au[i];
+        res = 0;
+        for (int i = 0; i < n; i++) {
+            au[i] -= theta * evecs[i]; // residual
+            res += au[i] * au[i];
+        }
+        res = sqrt(res);
+        evals[0] = theta;
+        if (res <= accept || step == MIXED_REFINE_STEPS) break;
+        if (step > 0 && res > 0.5 * prev && mv == matvec_float) {
+            mv = matvec_primme; // the single precision values limit the accuracy of the corrections
+        }
+        prev = res;
+        int k = correction_cg(mv, evecs, theta, au, t, w + 2*(size_t)n, MIXED_CG_TOL, MIXED_CG_MAXIT);
+        if (mv == matvec_float) cg_matvecs += k;
+        else {
+            double_matvecs += k;
+            double_steps++;
+        }
+        norm = 0;
+        for (int i = 0; i < n; i++) {
+            evecs[i] += t[i];
+            norm += evecs[i]*evecs[i];
+        }
+        for (int i = 0; i < n; i++) evecs[i] /= sqrt(norm);
+    }
+    tac(mytimer_wall, tf, "the double precision refinement");
+    free(w);
+    printf("mixed precision : %d + %d single (%d refinement steps, %d of them in double) and %d double matvecs\n",
+           float_matvecs, cg_matvecs, step, double_steps, double_matvecs);
+    printf("Minimal eigen value: %e, error : %e\n", evals[0], calc_res(prob, evecs, evals[0]));
+    last_stats.iterations = float_iterations + step;
+    last_stats.matvecs = float_matvecs + cg_matvecs + double_matvecs;
+    last_stats.preconds = 0;
+    if (res > accept) {
+        printf("\n ERROR : the mixed precision eigenpair was not accepted (residual %e)\n\n", res);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/// @brief gives the iterations, matvecs and preconditioner applications of the last minimal eigenvalue solve
+/// (the single and double precision phases together for the mixed precision solve)
+void primme_last_stats(solver_stats *st)
+{
+    st->iterations = last_stats.iterations;
+    st->matvecs = last_stats.matvecs;
+    st->preconds = last_stats.preconds;
+}
+
+/// @brief Calculate the lowest and highest eigen value of the matrix A of dimenssions primme_n x primme_n.
+/// Stored in the CSR format with the help of primme_ia, primme_ja, primme_a vectors
+/// @param min_evals minimal eigen value
+/// @param min_evecs eigen vector from minimal eigen value
+/// @param max_evals maximal eigen value
+/// @param max_evecs eigen vector from maximal eigen value
+/// @return integer for error handling
+/// @note max_evals can be set to NULL to skip the maximal eigenvalue solve
+///       (when dt_max is given by lanczos_bound() instead), and min_evals to NULL to skip the minimal
+///       one (when it is solved by another backend through solver_lowest())
+int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_evecs)
+{
+    double ti, tf;
+    int err;
+
+    #if MIXED_PRECISION && !STENCIL_9PT && !PRIMME_SHIFT_INVERT
+    if (min_evals != NULL && primme_mixed(min_evals, min_evecs)) return EXIT_FAILURE;
+    #else
+    if (min_evals != NULL && primme_lowest(min_evals, min_evecs, 0)) return EXIT_FAILURE;
+    #endif
+    if (max_evals == NULL) return EXIT_SUCCESS;
+
+    // residual norm buffer
+    double *resn = (double*)malloc(sizeof(double));
+    if (resn == NULL) {
+        printf("\n ERREUR : pas assez de mémoire pour un vecteur auxilier dans la fonction primme\n\n");
+        return 1;
+    }
+
+    primme_params primme;
     /* Max eigenvalue */
-    /* /!\ we have to reconfigure primme since dprimme de-initialized some parameters */
     primme_initialize (&primme);
+    #if STENCIL_9PT
+    primme.matrixMatvec = matvec_generalized;
+    #else
     primme.matrixMatvec = matvec_primme; 
+    #endif
     primme.n = n;
     primme.printLevel = 0; 
     primme.target = primme_largest; 
@@ -114,6 +597,10 @@ int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_
     }
     tac(mytimer_wall, tf, "primme to solve for maximal eigenvalue");
 
+    #if STENCIL_9PT
+    generalized_eigvec(max_evecs);
+    #endif
+
     printf("Maximal eigen value : %e, error : %e\n", max_evals[0], resn[0]);
 
     /* free memory */
@@ -2,11 +2,41 @@
 #define INTERFACE_PRIMME_H
 
 #include "./primme/PRIMMESRC/COMMONSRC/primme.h"
+#include "prob.h"
+#include "solver.h"
 
-int init_primme(int primme_n, int *primme_ia, int *primme_ja, double *primme_a);
+int init_primme(int primme_n, csr_off *primme_ia, int *primme_ja, double *primme_a);
+
+int init_primme_shift_invert(problem *s, double shift);
+
+int init_primme_precond(problem *s);
+
+int init_primme_generalized(problem *s);
+
+void matvec_generalized(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+void generalized_eigvec(double *v);
+
+int init_primme_float(problem *s);
+
+void matvec_float(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+int primme_mixed(double *evals, double *evecs);
+
+void matvec_operator(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+void matvec_shift_invert(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+void primme_operator_failed(void);
+
+int primme_lowest(double *evals, double *evecs, int initSize);
+
+void primme_last_stats(solver_stats *st);
 
 int primme(double *min_evals, double *min_evecs, double *max_evals, double *max_evecs);
 
 void matvec_primme(void *vx, void *vy, int *blockSize, primme_params *primme);
 
+void matvec_rowmajor(void *vx, void *vy, int *blockSize, primme_params *primme);
+
 #endif /* INTERFACE_PRIMME_H */
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "config.h"
 #include "time.h"
+#include "cholesky.h"
 
 /*
    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -16,17 +18,48 @@
    - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 */
 
+static int st_applications; // applications of the shell spectral transformation during the last solve
+
+#if SLEPC_SHIFT_INVERT
+/// @brief shell spectral transformation y = (A - sigma I)^-1 x with the cached cholesky factorization
+PetscErrorCode slepc_st_apply(ST st, Vec x, Vec y)
+{
+    problem *s;
+    const PetscScalar *px;
+    PetscScalar *py;
+    PetscCall(STShellGetContext(st, &s));
+    cholesky *f = cholesky_get(s, s->a, -SHIFT_INVERT_SIGMA, 1.0);
+    if (f == NULL) SETERRQ(PETSC_COMM_SELF, PETSC_ERR_MEM, "no cholesky factorization of A - sigma I");
+    PetscCall(VecGetArrayRead(x, &px));
+    PetscCall(VecGetArray(y, &py));
+    f->solve(f, (double*)px, py);
+    st_applications++;
+    PetscCall(VecRestoreArrayRead(x, &px));
+    PetscCall(VecRestoreArray(y, &py));
+    return 0;
+}
+
+/// @brief eigenvalue of A from the one of (A - sigma I)^-1
+PetscErrorCode slepc_st_backtransform(ST st, PetscInt n, PetscScalar *eigr, PetscScalar *eigi)
+{
+    for (PetscInt i = 0; i < n; i++) eigr[i] = SHIFT_INVERT_SIGMA + 1.0 / eigr[i];
+    return 0;
+}
+#endif
+
 /// @brief Solving with slepc the minimal eigen value problem
 /// @param evals a pointer to a double to store the asked eigen value
 /// @param evecs a pointer to an allocated space of n doubles to store the eigen vector
+/// @param st statistics of the solve (NULL if not needed), the matvecs of blopex are counted as one
+///           block of nev per iteration plus the initial one since slepc does not report them
 /// @return integer for error handling
-int slepc(problem *s, double *evals, double *evecs)
+int slepc(problem *s, double *evals, double *evecs, solver_stats *st)
 {
-    double ti, tf;
+    double ti, tf, t_start = mytimer_wall();
     PetscInt n = s->n;
     PetscInt nev = 1;
 
-    Mat A;
+    Mat A, B = NULL; // B is the mass matrix of the 9 point stencil
 
     EPS eps;
     PetscInt its, nconv, i;
@@ -35,7 +68,11 @@ int slepc(problem *s, double *evals, double *evecs)
     PetscScalar kr;
     Vec xr;
 
-    PetscCall(SlepcInitialize(NULL,NULL,(char*)0,NULL));
+    /* slepc can only be initialized once, it is finalized by slepc_finalize() at the end of the program
+       since it can be called by solver_lowest() and for the comparison with primme */
+    PetscBool initialized;
+    PetscCall(SlepcInitialized(&initialized));
+    if (!initialized) PetscCall(SlepcInitialize(NULL,NULL,(char*)0,NULL));
     // NULL -> giving no external source of parameters, everything will be defined by calling functions
 
     /* Matrix initialisation */
@@ -56,13 +93,26 @@ int slepc(problem *s, double *evals, double *evecs)
     PetscCall(MatSetFromOptions(A));
     PetscCall(MatSetUp(A));
     for (int i = 0; i < n; i++) {
-        for (int j = s->ia[i]; j < s->ia[i+1]; j++) {
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) {
             PetscCall(MatSetValue(A,i,s->ja[j],s->a[j],INSERT_VALUES));
         }
     }
 
     PetscCall(MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY));
     PetscCall(MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY));
+    if (s->b != NULL) {
+        // same pattern and preallocation as A
+        PetscCall(MatCreateSeqAIJ(PETSC_COMM_WORLD, n, n, 0, nnz, &B));
+        PetscCall(MatSetFromOptions(B));
+        PetscCall(MatSetUp(B));
+        for (int i = 0; i < n; i++) {
+            for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) {
+                PetscCall(MatSetValue(B,i,s->ja[j],s->b[j],INSERT_VALUES));
+            }
+        }
+        PetscCall(MatAssemblyBegin(B,MAT_FINAL_ASSEMBLY));
+        PetscCall(MatAssemblyEnd(B,MAT_FINAL_ASSEMBLY));
+    }
     free(nnz);
     tac(mytimer_wall, tf, "slepc matrix copy");
 
@@ -71,17 +121,33 @@ int slepc(problem *s, double *evals, double *evecs)
 
     /* Solver parameters */
     PetscCall(EPSCreate(PETSC_COMM_WORLD,&eps));
-    PetscCall(EPSSetOperators(eps,A,NULL)); // A.x = lambda.B.x, B=NULL
+    PetscCall(EPSSetOperators(eps,A,B)); // A.x = lambda.B.x, B=NULL for the 5 point stencil
+    #if SLEPC_SHIFT_INVERT && !STENCIL_9PT
+    /* the factorization of A - sigma I is shared with primme and the implicit time steps,
+       slepc only sees it through a shell spectral transformation */
+    ST shell;
+    PetscCall(EPSSetType(eps, EPSKRYLOVSCHUR));
+    PetscCall(EPSGetST(eps, &shell));
+    PetscCall(STSetType(shell, STSHELL));
+    PetscCall(STShellSetContext(shell, s));
+    PetscCall(STShellSetApply(shell, slepc_st_apply));
+    PetscCall(STShellSetBackTransform(shell, slepc_st_backtransform));
+    PetscCall(EPSSetProblemType(eps,EPS_HEP));
+    PetscCall(EPSSetWhichEigenpairs(eps,EPS_LARGEST_MAGNITUDE));
+    #else
     PetscCall(EPSSetType(eps, EPSBLOPEX));
     // this is the solution method, here we use blopex : specialized for minimal eigenvalue retrieval 
-    PetscCall(EPSSetProblemType(eps,EPS_HEP)); // Hermitian eigenvalue problem
+    PetscCall(EPSSetProblemType(eps,(B == NULL) ? EPS_HEP : EPS_GHEP)); // (generalized) Hermitian eigenvalue problem
 
     PetscCall(EPSSetWhichEigenpairs(eps,EPS_SMALLEST_REAL));
     // in the case of blopex, we coult omit this line since we are already searching for the minimal eigenvalue
+    #endif
 
     PetscCall(EPSSetFromOptions(eps));
     PetscCall(EPSSetDimensions(eps,nev,PETSC_DEFAULT,PETSC_DEFAULT));
 
+    double t_setup = mytimer_wall() - t_start;
+    st_applications = 0;
     tictac(PetscCall(EPSSolve(eps)), "slepc to solve", mytimer_wall, ti, tf);
     
     #if SLEPC_CONFIG_PRINT
@@ -94,6 +160,12 @@ int slepc(problem *s, double *evals, double *evecs)
 
     PetscCall(EPSGetIterationNumber(eps,&its));
     PetscCall(PetscPrintf(PETSC_COMM_WORLD," Number of iterations of the method: %" PetscInt_FMT "\n",its));
+    if (st != NULL) {
+        st->setup = t_setup;
+        st->iterations = its;
+        st->matvecs = (st_applications > 0) ? st_applications : (its + 1) * nev;
+        st->preconds = 0;
+    }
     PetscCall(EPSGetConverged(eps,&nconv));
     PetscCall(PetscPrintf(PETSC_COMM_WORLD," Number of converged eigenpairs: %" PetscInt_FMT "\n",nconv));
 
@@ -128,11 +200,111 @@ int slepc(problem *s, double *evals, double *evecs)
         evecs[i] = temp[i];
     }
     PetscCall(VecRestoreArray(xr, &temp));
+    if (B != NULL) {
+        // slepc normalizes with the B norm, primme gives a unit vector
+        double norm = 0;
+        for (int i = 0; i < n; i++) norm += evecs[i]*evecs[i];
+        norm = sqrt(norm);
+        for (int i = 0; i < n; i++) evecs[i] /= norm;
+    }
 
     /* free heap memory */
     PetscCall(EPSDestroy(&eps));
     PetscCall(MatDestroy(&A));
+    if (B != NULL) PetscCall(MatDestroy(&B));
     PetscCall(VecDestroy(&xr));
+    return EXIT_SUCCESS;
+}
+
+/// @brief finalizes slepc if slepc() initialized it
+/// @return integer for error handling
+int slepc_finalize(void)
+{
+    PetscBool initialized;
+    PetscCall(SlepcInitialized(&initialized));
+    if (initialized) PetscCall(SlepcFinalize());
+    return EXIT_SUCCESS;
+}
+
+#if USE_MPI
+/// @brief Solving with slepc the minimal eigen value problem on all the ranks,
+///        each one holds the rows of its strip in a parallel AIJ matrix
+/// @param d the local part of the problem (row range of the rank and its local CSR)
+/// @param evals a pointer to a double to store the asked eigen value
+/// @return integer for error handling
+int slepc_dist(dist_problem *d, double *evals)
+{
+    double ti, tf;
+    Mat A;
+    EPS eps;
+    PetscInt its, nconv;
+    PetscScalar kr;
+    PetscReal error;
+
+    PetscCall(SlepcInitialize(NULL,NULL,(char*)0,NULL));
+    // MPI is already initialized by main, slepc will not finalize it
+
+    /* preallocation : non-zeros in the diagonal block (owned columns) and outside of it */
+    tic(MPI_Wtime, ti);
+    int own0 = d->nghost_lo, own1 = d->nghost_lo + d->nrows; // owned part of the local vector
+    PetscInt *d_nnz = (PetscInt*)malloc(2 * d->nrows * sizeof(PetscInt));
+    if (d_nnz == NULL) return EXIT_FAILURE;
+    PetscInt *o_nnz = d_nnz + d->nrows;
+    int max_row = 0;
+    for (int i = 0; i < d->nrows; i++) {
+        d_nnz[i] = o_nnz[i] = 0;
+        for (int j = d->ia[i]; j < d->ia[i+1]; j++) {
+            if (d->ja[j] >= own0 && d->ja[j] < own1) d_nnz[i]++;
+            else o_nnz[i]++;
+        }
+        if (d->ia[i+1] - d->ia[i] > max_row) max_row = d->ia[i+1] - d->ia[i];
+    }
+    // global columns of a row, converted since PetscInt may be 64 bit (--with-64-bit-indices)
+    PetscInt *cols = (PetscInt*)malloc(max_row * sizeof(PetscInt));
+    if (cols == NULL) return EXIT_FAILURE;
+    PetscCall(MatCreateAIJ(PETSC_COMM_WORLD, d->nrows, d->nrows, d->n, d->n, 0, d_nnz, 0, o_nnz, &A));
+    PetscCall(MatSetFromOptions(A));
+    PetscCall(MatSetUp(A));
+    for (int i = 0; i < d->nrows; i++) {
+        PetscInt g = d->row0 + i;
+        for (int j = d->ia[i]; j < d->ia[i+1]; j++) cols[j - d->ia[i]] = (PetscInt)d->col0 + d->ja[j];
+        PetscCall(MatSetValues(A, 1, &g, d->ia[i+1]-d->ia[i], cols, &d->a[d->ia[i]], INSERT_VALUES));
+    }
+    PetscCall(MatAssemblyBegin(A,MAT_FINAL_ASSEMBLY));
+    PetscCall(MatAssemblyEnd(A,MAT_FINAL_ASSEMBLY));
+    free(d_nnz);
+    free(cols);
+    tf = MPI_Wtime();
+    PetscCall(PetscPrintf(PETSC_COMM_WORLD, "-> time taken for slepc parallel matrix copy was %e seconds\n", tf-ti));
+
+    PetscCall(EPSCreate(PETSC_COMM_WORLD,&eps));
+    PetscCall(EPSSetOperators(eps,A,NULL));
+    PetscCall(EPSSetType(eps, EPSBLOPEX));
+    PetscCall(EPSSetProblemType(eps,EPS_HEP));
+    PetscCall(EPSSetWhichEigenpairs(eps,EPS_SMALLEST_REAL));
+    PetscCall(EPSSetFromOptions(eps));
+    PetscCall(EPSSetDimensions(eps,1,PETSC_DEFAULT,PETSC_DEFAULT));
+
+    ti = MPI_Wtime();
+    PetscCall(EPSSolve(eps));
+    tf = MPI_Wtime();
+    PetscCall(PetscPrintf(PETSC_COMM_WORLD, "-> time taken for slepc to solve on %d ranks was %e seconds\n", d->size, tf-ti));
+
+    PetscCall(EPSGetIterationNumber(eps,&its));
+    PetscCall(PetscPrintf(PETSC_COMM_WORLD," Number of iterations of the method: %" PetscInt_FMT "\n",its));
+    PetscCall(EPSGetConverged(eps,&nconv));
+    if (nconv == 0) {
+        PetscCall(PetscPrintf(PETSC_COMM_WORLD, "0 converged eigenvalues\n"));
+        return EXIT_FAILURE;
+    }
+    PetscCall(EPSGetEigenpair(eps,0,&kr,NULL,NULL,NULL));
+    PetscCall(EPSComputeError(eps,0,EPS_ERROR_RELATIVE,&error));
+    PetscCall(PetscPrintf(PETSC_COMM_WORLD," eigenvalue calculated : %12e, error : %12g\n",(double)kr,(double)error));
+    evals[0] = kr;
+
+    PetscCall(EPSDestroy(&eps));
+    PetscCall(MatDestroy(&A));
     PetscCall(SlepcFinalize());
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#endif
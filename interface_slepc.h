@@ -2,7 +2,15 @@
 #define INTERFACE_SLEPC_H
 
 #include "prob.h"
+#include "distributed.h"
+#include "solver.h"
 
-int slepc(problem *s, double *evals, double *evecs);
+int slepc(problem *s, double *evals, double *evecs, solver_stats *st);
+
+int slepc_finalize(void);
+
+#if USE_MPI
+int slepc_dist(dist_problem *d, double *evals);
+#endif
 
 #endif // !INTERFACE_SLEPC_H
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "prob.h"
+#include "kernels.h"
+#include "config.h"
+
+/// @brief times every instantiation of the kernel library on the problem of config.h
+/// usage : ./kernel_bench [m] [reps]
+int main(int argc, char *argv[])
+{
+    int m = (argc > 1) ? atoi(argv[1]) : M_UNIT_STEPS;
+    int reps = (argc > 2) ? atoi(argv[2]) : 20;
+    const char *names[3] = {"csr", "symmetric", "stencil"};
+    const int widths[5] = {1, 2, 4, 8, 16};
+
+    pos2d shape = {4,5};
+    Rectangle sub_shape; init_rectangle(&sub_shape, 1, 2, 1, 3);
+    problem p; if (init_problem(&p, m, shape, sub_shape)) return EXIT_FAILURE;
+    p.generate_mat(&p);
+    if (kernels_init(p.n, p.ia, p.ja, p.a)) return EXIT_FAILURE;
+    kernels_grid(&p);
+
+    printf("m = %5d   n = %8d  nnz = %9lld   %d products per instantiation\n", m, p.n, (long long)p.ia[p.n], reps);
+    #if ARENA_ALLOCATOR
+    printf("arena : %zu bytes, %s pages, %s\n", p.mem.size, p.mem.huge == 2 ? "explicit huge" : (p.mem.huge ? "transparent huge" : "4K"),
+           p.mem.reused ? "reused" : "new");
+    #endif
+    printf("%-10s %-7s %5s %14s %14s %12s\n", "variant", "scalar", "width", "ns/row/vector", "speedup", "deviation");
+    for (int v = KERNEL_CSR; v <= KERNEL_STENCIL; v++) {
+        for (int single = 0; single <= 1; single++) {
+            double t1 = 0;
+            for (int w = 0; w < 5; w++) {
+                double dev;
+                double t = kernel_bench(v, widths[w], single, reps, &dev);
+                if (t < 0) {
+                    printf("%-10s %-7s %5d %14s\n", names[v], single ? "float" : "double", widths[w], "unavailable");
+                    continue;
+                }
+                if (w == 0) t1 = t;
+                printf("%-10s %-7s %5d %14.3f %14.2f %12.2e\n", names[v], single ? "float" : "double", widths[w],
+                       1e9 * t / p.n, t1 / t, dev);
+            }
+        }
+    }
+
+    p.close(&p);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,344 @@
+#include "kernels.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "time.h"
+
+/* operator storage for every variant and precision, filled by kernels_init() and kernels_grid() */
+static int n, *ja;
+static csr_off *ia;
+static double *a;
+static float *af;
+static csr_off *up_ia; // upper triangle, the diagonal is the first element of each row
+static int *up_ja;
+static double *up_a;
+static float *up_af;
+static int nx, ny, *inds; // grid of the 5 point stencil, inds == NULL if it is not available
+static double invh2;
+static int variant = KERNEL_VARIANT;
+
+template <typename T> static const T *csr_values();
+template <> const double *csr_values<double>() { return a; }
+template <> const float *csr_values<float>() { return af; }
+
+template <typename T> static const T *upper_values();
+template <> const double *upper_values<double>() { return up_a; }
+template <> const float *upper_values<float>() { return up_af; }
+
+/// @brief y = A x for the W vectors of a column-major block (x[b*n + i]) from the CSR rows :
+/// each element of the matrix is read once for the W vectors, the W sums stay in registers
+template <typename T, int W>
+static void csr_block(const T *x, T *y)
+{
+    const T *val = csr_values<T>();
+    for (int i = 0; i < n; i++) {
+        T acc[W];
+        for (int b = 0; b < W; b++) acc[b] = 0;
+        for (csr_off j = ia[i]; j < ia[i+1]; j++) {
+            const T aj = val[j];
+            const T *xj = x + ja[j];
+            for (int b = 0; b < W; b++) acc[b] += aj * xj[b*n];
+        }
+        for (int b = 0; b < W; b++) y[b*n + i] = acc[b];
+    }
+}
+
+/// @brief y = A x from the upper triangle : the element (i, j) gives a_ij x_j to row i and a_ij x_i to row j
+template <typename T, int W>
+static void symmetric_block(const T *x, T *y)
+{
+    const T *val = upper_values<T>();
+    for (int b = 0; b < W; b++) memset(y + b*n, 0, n * sizeof(T));
+    for (int i = 0; i < n; i++) {
+        T acc[W], xi[W];
+        const T d = val[up_ia[i]];
+        for (int b = 0; b < W; b++) {
+            xi[b] = x[b*n + i];
+            acc[b] = d * xi[b];
+        }
+        for (csr_off j = up_ia[i] + 1; j < up_ia[i+1]; j++) {
+            const T aj = val[j];
+            const int c = up_ja[j];
+            for (int b = 0; b < W; b++) {
+                acc[b] += aj * x[b*n + c];
+                y[b*n + c] += aj * xi[b];
+            }
+        }
+        for (int b = 0; b < W; b++) y[b*n + i] += acc[b];
+    }
+}
+
+/// @brief y = A x for the 5 point stencil without any matrix : the neighbors are found in the grid
+template <typename T, int W>
+static void stencil_block(const T *x, T *y)
+{
+    const T c = (T)invh2, c4 = (T)(4.0 * invh2);
+    for (int iy = 0; iy < ny; iy++) {
+        for (int ix = 0; ix < nx; ix++) {
+            const int g = ix + nx * iy, i = inds[g];
+            if (i == -1) continue;
+            const int s = (iy > 0) ? inds[g - nx] : -1;
+            const int w = (ix > 0) ? inds[g - 1] : -1;
+            const int e = (ix < nx - 1) ? inds[g + 1] : -1;
+            const int no = (iy < ny - 1) ? inds[g + nx] : -1;
+            for (int b = 0; b < W; b++) {
+                const T *xb = x + b*n;
+                T v = c4 * xb[i];
+                if (s != -1) v -= c * xb[s];
+                if (w != -1) v -= c * xb[w];
+                if (e != -1) v -= c * xb[e];
+                if (no != -1) v -= c * xb[no];
+                y[b*n + i] = v;
+            }
+        }
+    }
+}
+
+/// @brief the instantiation of one variant for W vectors
+template <typename T, int W>
+static void apply(int v, const T *x, T *y)
+{
+    switch (v) {
+        case KERNEL_SYMMETRIC: symmetric_block<T, W>(x, y); break;
+        case KERNEL_STENCIL: stencil_block<T, W>(x, y); break;
+        default: csr_block<T, W>(x, y);
+    }
+}
+
+/// @brief runtime dispatch of a block of bs vectors on the widths 16, 8, 4, 2 and 1
+template <typename T>
+static void apply_block(int v, const T *x, T *y, int bs)
+{
+    int b0 = 0;
+    for (; b0 + 16 <= bs; b0 += 16) apply<T, 16>(v, x + b0*n, y + b0*n);
+    if (b0 + 8 <= bs) { apply<T, 8>(v, x + b0*n, y + b0*n); b0 += 8; }
+    if (b0 + 4 <= bs) { apply<T, 4>(v, x + b0*n, y + b0*n); b0 += 4; }
+    if (b0 + 2 <= bs) { apply<T, 2>(v, x + b0*n, y + b0*n); b0 += 2; }
+    if (b0 < bs) apply<T, 1>(v, x + b0*n, y + b0*n);
+}
+
+/// @brief the variant that can be used : the stencil needs the grid, the others the CSR matrix
+static int active_variant(void)
+{
+    if (variant == KERNEL_STENCIL && inds == NULL) return KERNEL_CSR;
+    return variant;
+}
+
+/// @brief u -= dtd * v and sum of v^2, with U independent partial sums so that the loop is vectorized
+template <typename T, int U>
+static double euler(T *u, const T *v, int len, T dtd)
+{
+    T acc[U];
+    for (int k = 0; k < U; k++) acc[k] = 0;
+    int i = 0;
+    for (; i + U <= len; i += U) {
+        for (int k = 0; k < U; k++) {
+            u[i+k] -= dtd * v[i+k];
+            acc[k] += v[i+k] * v[i+k];
+        }
+    }
+    double sum = 0;
+    for (; i < len; i++) {
+        u[i] -= dtd * v[i];
+        sum += v[i] * v[i];
+    }
+    for (int k = 0; k < U; k++) sum += acc[k];
+    return sum;
+}
+
+/// @brief ||A u - w2 u||^2 and ||u||^2 in one pass over the rows, without storing A u
+template <typename T>
+static void residual(problem *s, const T *u, T w2, double *res, double *norm)
+{
+    double r = 0, un = 0;
+    for (int i = 0; i < s->n; i++) {
+        T line = -w2 * u[i];
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) line += (T)s->a[j] * u[s->ja[j]];
+        r += line * line;
+        un += u[i] * u[i];
+    }
+    *res = r;
+    *norm = un;
+}
+
+/// @brief sum of (|u|-|v|)^2 and of u^2, fabs is what abs() of compare_vecs() resolves to in the C++ build
+template <typename T>
+static void compare(const T *u, const T *v, int len, double *umv, double *norm)
+{
+    double d2 = 0, un = 0;
+    for (int i = 0; i < len; i++) {
+        T diff = fabs(u[i]) - fabs(v[i]);
+        d2 += diff * diff;
+        un += u[i] * u[i];
+    }
+    *umv = d2;
+    *norm = un;
+}
+
+/// @brief frees the storage of the operator
+static void free_kernels(void)
+{
+    free(af); free(up_ia); free(up_ja); free(up_a); free(up_af);
+    af = NULL; up_ia = NULL; up_ja = NULL; up_a = NULL; up_af = NULL;
+    inds = NULL;
+}
+
+/// @brief to initialize the kernel library with the CSR matrix (the arrays are not copied),
+/// the single precision values and the upper triangle are built from it
+/// @param kernel_n number of unknowns in the system
+/// @param kernel_ia array 'ia' of matrix A
+/// @param kernel_ja array 'ja' of matrix A
+/// @param kernel_a array 'a' of matrix A
+/// @return integer for error handling
+int kernels_init(int kernel_n, csr_off *kernel_ia, int *kernel_ja, double *kernel_a)
+{
+    free_kernels();
+    n = kernel_n;
+    ia = kernel_ia;
+    ja = kernel_ja;
+    a = kernel_a;
+
+    csr_off nnz = ia[n], unnz = (nnz + n) / 2;
+    af = (float*)malloc(nnz * sizeof(float));
+    up_ia = (csr_off*)malloc((n + 1) * sizeof(csr_off));
+    up_ja = (int*)malloc(unnz * sizeof(int));
+    up_a = (double*)malloc(unnz * sizeof(double));
+    up_af = (float*)malloc(unnz * sizeof(float));
+    if (af == NULL || up_ia == NULL || up_ja == NULL || up_a == NULL || up_af == NULL) {
+        printf("\n ERROR : not enough memory for the kernel library\n\n");
+        return EXIT_FAILURE;
+    }
+    for (csr_off j = 0; j < nnz; j++) af[j] = (float)a[j];
+
+    /* upper triangle with the diagonal first : the columns of a row are sorted in the CSR matrix */
+    csr_off k = 0;
+    for (int i = 0; i < n; i++) {
+        up_ia[i] = k;
+        for (csr_off j = ia[i]; j < ia[i+1]; j++) {
+            if (ja[j] < i) continue;
+            up_ja[k] = ja[j];
+            up_a[k] = a[j];
+            up_af[k] = af[j];
+            k++;
+        }
+    }
+    up_ia[n] = k;
+    return EXIT_SUCCESS;
+}
+
+/// @brief gives the grid of the problem to the matrix-free variant (5 point stencil only)
+/// @param s the problem object, the matrix given to kernels_init() has to be its own
+/// @return integer for error handling, the CSR variant is used instead if the grid cannot be
+int kernels_grid(problem *s)
+{
+    inds = NULL;
+    if (s->b != NULL || s->n != n) {
+        printf("the matrix-free kernel only supports the 5 point stencil, the CSR kernel is used\n");
+        return EXIT_FAILURE;
+    }
+    nx = s->nx;
+    ny = s->ny;
+    inds = s->inds;
+    invh2 = (s->m-1)*(s->m-1);
+    return EXIT_SUCCESS;
+}
+
+/// @brief selects the operator variant (KERNEL_CSR, KERNEL_SYMMETRIC or KERNEL_STENCIL)
+/// @return the previous variant
+int kernels_variant(int v)
+{
+    int old = variant;
+    variant = v;
+    return old;
+}
+
+/// @brief Calculate vy = A*vx for the column-major block of vectors given by primme,
+/// the block is split on the widths 16, 8, 4, 2 and 1 which have their own instantiation
+/// @param vx input vector(s)
+/// @param vy output vector(s)
+/// @param blockSize number of vectors
+/// @param primme unused, can be set to NULL
+void kernel_matvec(void *vx, void *vy, int *blockSize, primme_params *primme)
+{
+    apply_block<double>(active_variant(), (const double*)vx, (double*)vy, *blockSize);
+}
+
+/// @brief Calculate y = A*x in single precision (vectors and values)
+void kernel_matvec_float(float *x, float *y, int blockSize)
+{
+    apply_block<float>(active_variant(), x, y, blockSize);
+}
+
+/// @brief progressive euler update uk -= dtd*vk
+/// @return sum of vk^2
+double kernel_euler(double *uk, double *vk, int n, double dtd)
+{
+    return euler<double, 8>(uk, vk, n, dtd);
+}
+
+/// @brief ||A u - w2 u||/||u|| in one pass (5 point stencil, the 9 point one needs B)
+double kernel_residual(problem *s, double *u, double w2)
+{
+    double res, norm;
+    residual<double>(s, u, w2, &res, &norm);
+    return sqrt(res / norm);
+}
+
+/// @brief ||(|u|-|v|)||/||u||, as compare_vecs()
+double kernel_compare(double *u, double *v, int n)
+{
+    double umv, un;
+    compare<double>(u, v, n, &umv, &un);
+    return sqrt(umv / un);
+}
+
+/// @brief times one instantiation of the matvec on a block of its width
+/// @param v variant (KERNEL_CSR, KERNEL_SYMMETRIC or KERNEL_STENCIL)
+/// @param width block width (16, 8, 4, 2 or 1)
+/// @param single 1 for the single precision instantiation
+/// @param reps number of products to time
+/// @param deviation max relative difference with the double precision CSR product
+/// @return seconds per product of one vector, negative if the variant is not available
+double kernel_bench(int v, int width, int single, int reps, double *deviation)
+{
+    double ti, tf;
+    if (v == KERNEL_STENCIL && inds == NULL) return -1;
+    double *x = (double*)malloc(2 * width * n * sizeof(double));
+    float *xf = (float*)malloc(2 * width * n * sizeof(float));
+    if (x == NULL || xf == NULL) {
+        free(x); free(xf);
+        return -1;
+    }
+    double *y = x + width * n;
+    float *yf = xf + width * n;
+    for (int i = 0; i < width * n; i++) {
+        x[i] = sin(0.001 * i) + 1.0;
+        xf[i] = (float)x[i];
+    }
+
+    ti = mytimer_wall();
+    for (int r = 0; r < reps; r++) {
+        if (single) apply_block<float>(v, xf, yf, width);
+        else apply_block<double>(v, x, y, width);
+    }
+    tf = mytimer_wall();
+
+    /* check against the double precision CSR product */
+    double *ref = (double*)malloc(width * n * sizeof(double));
+    if (ref == NULL) {
+        free(x); free(xf);
+        return -1;
+    }
+    apply_block<double>(KERNEL_CSR, x, ref, width);
+    double dev = 0, scale = 0;
+    for (int i = 0; i < width * n; i++) {
+        double yi = single ? yf[i] : y[i];
+        dev = fmax(dev, fabs(yi - ref[i]));
+        scale = fmax(scale, fabs(ref[i]));
+    }
+    *deviation = dev / scale;
+
+    free(x); free(xf); free(ref);
+    return (tf - ti) / ((double)reps * width);
+}
@@ -0,0 +1,41 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "./primme/PRIMMESRC/COMMONSRC/primme.h"
+#include "prob.h"
+
+/* operator variants of the kernel library (KERNEL_VARIANT in config.h) */
+#define KERNEL_CSR 0 // rows of the CSR matrix (ia, ja, a)
+#define KERNEL_SYMMETRIC 1 // upper triangle only, each stored element is used for its row and its column
+#define KERNEL_STENCIL 2 // matrix-free 5 point stencil read from the grid (inds), neither ja nor a is read
+
+/* the kernels are C++ templates (kernels.cpp) : the matvec is specialized on the scalar type, the block width
+   and the operator variant, the euler, residual and compare kernels only on the scalar type since their callers
+   (temperature_iterate, calc_res, compare_vecs) work on one vector. The functions below are the C interface to them */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int kernels_init(int kernel_n, csr_off *kernel_ia, int *kernel_ja, double *kernel_a);
+
+int kernels_grid(problem *s);
+
+int kernels_variant(int v);
+
+void kernel_matvec(void *vx, void *vy, int *blockSize, primme_params *primme);
+
+void kernel_matvec_float(float *x, float *y, int blockSize);
+
+double kernel_euler(double *uk, double *vk, int n, double dtd);
+
+double kernel_residual(problem *s, double *u, double w2);
+
+double kernel_compare(double *u, double *v, int n);
+
+double kernel_bench(int variant, int width, int single, int reps, double *deviation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !KERNELS_H
@@ -0,0 +1,225 @@
+#include "lobpcg.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+
+/* eigenvalues and eigenvectors of a small symmetric matrix (lapack) */
+#ifdef __cplusplus
+extern "C"
+#endif
+void dsyev_(const char *jobz, const char *uplo, const int *n, double *a, const int *lda, double *w,
+            double *work, const int *lwork, int *info);
+
+static double dot(int n, const double *u, const double *v) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += u[i] * v[i];
+    return sum;
+}
+
+static void axpy(int n, double c, const double *u, double *v) {
+    for (int i = 0; i < n; i++) v[i] += c * u[i];
+}
+
+/// @brief orthonormalizes the nv columns of v against the nu orthonormal columns of u and against each other
+/// (classical gram-schmidt done twice), the columns that are linearly dependent are dropped
+/// @param av A v, updated with the same combinations, NULL if it is not known yet
+/// @param au A u, only read if av is given
+/// @return number of columns kept, they are moved to the first columns of v (and av)
+static int orthonormalize(int n, double *v, double *av, int nv, const double *u, const double *au, int nu) {
+    int kept = 0;
+    for (int j = 0; j < nv; j++) {
+        double *x = v + (size_t)j*n, *ax = (av != NULL) ? av + (size_t)j*n : NULL;
+        double norm0 = sqrt(dot(n, x, x));
+        if (norm0 == 0) continue;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int k = 0; k < nu + kept; k++) {
+                const double *q = (k < nu) ? u + (size_t)k*n : v + (size_t)(k-nu)*n;
+                double c = dot(n, q, x);
+                axpy(n, -c, q, x);
+                if (ax != NULL) axpy(n, -c, (k < nu) ? au + (size_t)k*n : av + (size_t)(k-nu)*n, ax);
+            }
+        }
+        double norm = sqrt(dot(n, x, x));
+        if (norm < 1e-10 * norm0) continue;
+        for (int i = 0; i < n; i++) x[i] /= norm;
+        if (ax != NULL) for (int i = 0; i < n; i++) ax[i] /= norm;
+        if (kept != j) {
+            memcpy(v + (size_t)kept*n, x, n * sizeof(double));
+            if (ax != NULL) memcpy(av + (size_t)kept*n, ax, n * sizeof(double));
+        }
+        kept++;
+    }
+    return kept;
+}
+
+/// @brief Rayleigh-Ritz on the orthonormal basis given by the columns cols (and A cols in acols) :
+/// the block of the bs lowest Ritz vectors goes to x (ax), the part of their combination coming from
+/// the columns first to m-1 goes to p (ap), the new search direction
+/// @param theta the bs lowest Ritz values
+/// @return integer for error handling
+static int rayleigh_ritz(int n, int m, int bs, double **cols, double **acols, int first,
+                         double *x, double *ax, double *p, double *ap, double *theta) {
+    double *g = (double*)malloc((m*m + m + 34*m) * sizeof(double));
+    if (g == NULL) return EXIT_FAILURE;
+    double *w = g + m*m, *work = w + m;
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j <= i; j++) {
+            double gij = 0.5 * (dot(n, cols[i], acols[j]) + dot(n, cols[j], acols[i]));
+            g[i + j*m] = g[j + i*m] = gij;
+        }
+    int lwork = 34*m, info;
+    dsyev_("V", "U", &m, g, &m, w, work, &lwork, &info);
+    if (info != 0) {
+        printf("\n ERROR : lapack dsyev failed in lobpcg (info = %d)\n\n", info);
+        free(g);
+        return EXIT_FAILURE;
+    }
+    for (int j = 0; j < bs; j++) {
+        double *xj = x + (size_t)j*n, *axj = ax + (size_t)j*n;
+        memset(xj, 0, n * sizeof(double));
+        memset(axj, 0, n * sizeof(double));
+        for (int i = 0; i < m; i++) {
+            axpy(n, g[i + j*m], cols[i], xj);
+            axpy(n, g[i + j*m], acols[i], axj);
+        }
+        if (p != NULL) {
+            double *pj = p + (size_t)j*n, *apj = ap + (size_t)j*n;
+            memset(pj, 0, n * sizeof(double));
+            memset(apj, 0, n * sizeof(double));
+            for (int i = first; i < m; i++) {
+                axpy(n, g[i + j*m], cols[i], pj);
+                axpy(n, g[i + j*m], acols[i], apj);
+            }
+        }
+        theta[j] = w[j];
+    }
+    free(g);
+    return EXIT_SUCCESS;
+}
+
+/// @brief default parameters : block of nev + 2 columns, no preconditioner, tolerance LOBPCG_TOL
+/// (relative, to be multiplied by an estimate of ||A|| by the caller)
+void lobpcg_default(lobpcg_params *prm, int n, int nev, matvec_t matvec) {
+    prm->n = n;
+    prm->nev = nev;
+    prm->block = (nev + 2 < n) ? nev + 2 : n;
+    prm->maxit = LOBPCG_MAXIT;
+    prm->initSize = 0;
+    prm->tol = LOBPCG_TOL;
+    prm->matvec = matvec;
+    prm->precond = NULL;
+    prm->precond_ctx = NULL;
+    prm->iterations = prm->matvecs = prm->preconds = 0;
+}
+
+/// @brief Locally optimal block preconditioned conjugate gradient (Knyazev) for the lowest eigenpairs of a
+/// symmetric operator : each iteration does a Rayleigh-Ritz on [X, T R, P] with X the current block,
+/// R its residuals, T the preconditioner and P the previous directions.
+/// The columns that converged are not expanded anymore (soft locking)
+/// @param prm parameters, the statistics are written back in it
+/// @param evals the nev lowest eigenvalues
+/// @param evecs the nev eigenvectors (column-major, n x nev), holds the initial guesses on entry if initSize > 0
+/// @param resn residual norms of the nev eigenpairs
+/// @return integer for error handling
+int lobpcg(lobpcg_params *prm, double *evals, double *evecs, double *resn) {
+    int n = prm->n, nev = prm->nev, bs = prm->block;
+    if (bs < nev) bs = nev;
+    if (3*bs > n) bs = (3*nev > n) ? nev : n / 3;
+    size_t blk = (size_t)bs * n;
+    double *mem = (double*)malloc(10 * blk * sizeof(double));
+    double *theta = (double*)malloc(2 * bs * sizeof(double));
+    double **cols = (double**)malloc(6 * bs * sizeof(double*));
+    if (mem == NULL || theta == NULL || cols == NULL) {
+        printf("\n ERROR : not enough memory for lobpcg (block of %d vectors)\n\n", bs);
+        free(mem); free(theta); free(cols);
+        return EXIT_FAILURE;
+    }
+    /* X and P are contiguous (and AX, AP) so that W is orthonormalized against both at once */
+    double *x = mem, *p = x + blk, *ax = p + blk, *ap = ax + blk, *w = ap + blk, *aw = w + blk;
+    double *xn = aw + blk, *axn = xn + blk, *pn = axn + blk, *apn = pn + blk;
+    double *res = theta + bs, **acols = cols + 3*bs;
+    primme_params ctx;
+    memset(&ctx, 0, sizeof(primme_params));
+    ctx.n = n;
+    ctx.preconditioner = prm->precond_ctx;
+    prm->iterations = prm->matvecs = prm->preconds = 0;
+
+    /* initial block : the guesses, then a positive vector (close to the lowest mode) and random ones */
+    int init = (prm->initSize < bs) ? prm->initSize : bs;
+    memcpy(x, evecs, (size_t)init * n * sizeof(double));
+    unsigned int seed = 12345;
+    for (int j = init; j < bs; j++)
+        for (int i = 0; i < n; i++) {
+            seed = seed * 1103515245u + 12345u;
+            x[(size_t)j*n + i] = (j == 0 ? 1.0 : 0.0) + (double)(seed >> 8) / (1u << 24) - 0.5;
+        }
+    if (orthonormalize(n, x, NULL, bs, NULL, NULL, 0) < bs) {
+        printf("\n ERROR : the initial block of lobpcg is rank deficient\n\n");
+        free(mem); free(theta); free(cols);
+        return EXIT_FAILURE;
+    }
+    prm->matvec(x, ax, &bs, &ctx);
+    prm->matvecs += bs;
+    for (int j = 0; j < bs; j++) { cols[j] = x + (size_t)j*n; acols[j] = ax + (size_t)j*n; }
+    int err = rayleigh_ritz(n, bs, bs, cols, acols, bs, xn, axn, NULL, NULL, theta);
+
+    int np = 0, converged = 0;
+    for (prm->iterations = 0; !err && prm->iterations < prm->maxit; prm->iterations++) {
+        memcpy(x, xn, blk * sizeof(double));
+        memcpy(ax, axn, blk * sizeof(double));
+        if (np > 0) {
+            memcpy(p, pn, blk * sizeof(double));
+            memcpy(ap, apn, blk * sizeof(double));
+        }
+
+        /* residuals of the block, W = T R for the columns that did not converge */
+        int nw = 0;
+        converged = 1;
+        for (int j = 0; j < bs; j++) {
+            double *r = w + (size_t)nw*n;
+            for (int i = 0; i < n; i++) r[i] = ax[(size_t)j*n + i] - theta[j] * x[(size_t)j*n + i];
+            res[j] = sqrt(dot(n, r, r));
+            if (res[j] > prm->tol) {
+                nw++;
+                if (j < nev) converged = 0;
+            }
+        }
+        if (converged) break;
+        if (prm->precond != NULL) {
+            prm->precond(w, aw, &nw, &ctx);
+            prm->preconds += nw;
+            memcpy(w, aw, (size_t)nw * n * sizeof(double));
+        }
+
+        /* orthonormal basis [X, W, P] */
+        np = orthonormalize(n, p, ap, np, x, ax, bs);
+        nw = orthonormalize(n, w, NULL, nw, x, NULL, bs + np);
+        if (nw == 0) break; // stagnation, the residuals are in the span of X and P
+        prm->matvec(w, aw, &nw, &ctx);
+        prm->matvecs += nw;
+
+        int m = 0;
+        for (int j = 0; j < bs; j++, m++) { cols[m] = x + (size_t)j*n; acols[m] = ax + (size_t)j*n; }
+        for (int j = 0; j < nw; j++, m++) { cols[m] = w + (size_t)j*n; acols[m] = aw + (size_t)j*n; }
+        for (int j = 0; j < np; j++, m++) { cols[m] = p + (size_t)j*n; acols[m] = ap + (size_t)j*n; }
+        err = rayleigh_ritz(n, m, bs, cols, acols, bs, xn, axn, pn, apn, theta);
+        np = bs;
+    }
+
+    if (!err) {
+        memcpy(evecs, xn, (size_t)nev * n * sizeof(double)); // xn is x if the loop stopped on convergence
+        for (int j = 0; j < nev; j++) {
+            evals[j] = theta[j];
+            resn[j] = res[j];
+        }
+        if (!converged) {
+            printf("\n ERROR : lobpcg did not converge in %d iterations (residual %e for a tolerance %e)\n\n",
+                   prm->iterations, res[nev-1], prm->tol);
+            err = EXIT_FAILURE;
+        }
+    }
+    free(mem); free(theta); free(cols);
+    return err;
+}
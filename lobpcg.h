@@ -0,0 +1,26 @@
+#ifndef LOBPCG_H
+#define LOBPCG_H
+
+#include "temperature.h"
+
+/* parameters and statistics of the native LOBPCG solver, the operator and the preconditioner
+   have the signature of the primme callbacks so that the same functions can be used */
+typedef struct {
+    int n; // number of unknowns
+    int nev; // number of wanted eigenpairs (the lowest ones)
+    int block; // columns of the block, nev at least : the extra ones speed up the convergence of the last wanted
+    int maxit; // maximum number of iterations
+    int initSize; // number of initial guesses in evecs
+    double tol; // convergence when ||A x - lambda x|| <= tol for a unit x
+    matvec_t matvec;
+    matvec_t precond; // approximation of A^-1, NULL for none
+    void *precond_ctx; // given to precond as primme->preconditioner
+    /* statistics */
+    int iterations, matvecs, preconds;
+} lobpcg_params;
+
+void lobpcg_default(lobpcg_params *prm, int n, int nev, matvec_t matvec);
+
+int lobpcg(lobpcg_params *prm, double *evals, double *evecs, double *resn);
+
+#endif // !LOBPCG_H
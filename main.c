@@ -3,12 +3,22 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <signal.h>
+#include <string.h>
 #include "prob.h"
 #include "time.h"
 #include "interface_primme.h"
 #include "interface_slepc.h"
 #include "gnuplot.h" 
 #include "temperature.h"
+#include "spectral.h"
+#include "ensemble.h"
+#include "richardson.h"
+#include "holeopt.h"
+#include "csrfile.h"
+#include "kernels.h"
+#include "distributed.h"
+#include "checkpoint.h"
+#include "solver.h"
 #include "config.h"
 
 static volatile bool running = true;
@@ -20,8 +30,39 @@ void gnuplot_loop_handler(int dummy) {
   running = false;
 }
 
+#if CHECKPOINT_EVERY && SHOW_TEMPERATURE_EVOL
+/// @brief gives the state of the heat loop that goes in the next checkpoint, from the geometry of ck->state
+/// @param frame iteration of the frame loop to resume from
+/// @param rk the RKC integrator, NULL for the euler methods
+static checkpoint_state heat_state(checkpoint *ck, int frame, double t, double lambda_max, rkc *rk, heat_monitor *hm,
+                                   int matvecs, double step_time) {
+  checkpoint_state state = ck->state;
+  checkpoint_state *c = &state;
+  c->frame = frame;
+  c->t = t;
+  c->lambda_max = lambda_max;
+  c->matvecs = matvecs;
+  if (rk != NULL) {
+    c->dt = rk->dt;
+    c->matvecs = rk->matvecs;
+    c->steps = rk->steps;
+    c->rejected = rk->rejected;
+    c->max_stages = rk->max_stages;
+  }
+  c->frames = hm->frames;
+  c->skipped = hm->skipped;
+  c->rate = hm->rate;
+  c->step_time = step_time;
+  return state;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
+  #if USE_MPI
+  MPI_Init(&argc, &argv);
+  #endif
+
   vspace;
 
   int m = M_UNIT_STEPS;
@@ -31,25 +72,80 @@ int main(int argc, char *argv[])
   pos2d shape = {4,5}; // size of membrane
   Rectangle sub_shape; init_rectangle(&sub_shape, 1, 2, 1, 3); // size of hole
   /* /!\ this program only support holes that don't overlap the membrane edges */
-  broadcast("Problem Initialisation")
+  #if RICHARDSON_LEVELS > 2 && !USE_MPI
+  broadcast("richardson extrapolation of the minimal eigenvalue")
+  richardson_result rr;
+  tic(mytimer_wall, ti);
+  if (richardson(shape, sub_shape, RICHARDSON_M0, RICHARDSON_LEVELS, &rr)) return EXIT_FAILURE;
+  tac(mytimer_wall, tf, "the richardson driver");
+  printf("estimated order : %f\n", rr.order);
+  printf("extrapolated minimal eigen value : %.12e +- %e\n", rr.extrapolated, rr.error);
+  vspace;
+  #endif
+
+  bool load = LOAD_MAT[0] != '\0'; // the matrix and its geometry are read from LOAD_MAT instead of generated
+
+  #if HOLE_OPTIMIZER && !USE_MPI
+  holeopt_result hr;
+  if (!load) {
+    broadcast("optimization of the hole position")
+    tic(mytimer_wall, ti);
+    if (holeopt(shape, sub_shape, m, &hr)) return EXIT_FAILURE;
+    tac(mytimer_wall, tf, "the hole optimizer");
+    printf("hole [%d, %d] x [%d, %d] -> [%d, %d] x [%d, %d] (grid indices) in %d moves, %d solves, %d matvecs\n",
+           hr.hole0.x[0], hr.hole0.x[1], hr.hole0.y[0], hr.hole0.y[1],
+           hr.hole.x[0], hr.hole.x[1], hr.hole.y[0], hr.hole.y[1], hr.moves, hr.solves, hr.matvecs);
+    printf("minimal eigen value : %.12e -> %.12e   (d lambda/dx = %e, d lambda/dy = %e)\n",
+           hr.lambda0, hr.lambda, hr.gradient[0], hr.gradient[1]);
+    vspace;
+  }
+  #endif
+
+  #if USE_MPI
+  /* every rank generates only its strip of the matrix, the sequential program below is not run */
+  if (load) {
+    printf("\n ERROR : LOAD_MAT is not supported with USE_MPI, the strips are generated from the grid\n\n");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  // a failing rank would leave the others waiting in the collectives
+  if (distributed_run(m, shape, get_sub_shape_indices(&sub_shape, m))) MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+  #endif
 
-  problem p; if (init_problem(&p, m, shape, sub_shape)) return EXIT_FAILURE;
+  broadcast("Problem Initialisation")
 
-  tictac(p.generate_mat(&p),"generating problem matrix", mytimer_wall, ti, tf);
+  problem p;
+  if (load) {
+    tic(mytimer_wall, ti);
+    if (csr_load(&p, LOAD_MAT)) return EXIT_FAILURE;
+    tac(mytimer_wall, tf, "loading problem matrix");
+    m = p.m;
+  } else {
+    #if HOLE_OPTIMIZER && !USE_MPI
+    if (init_problem_grid(&p, m, shape, hr.hole)) return EXIT_FAILURE;
+    #else
+    if (init_problem(&p, m, shape, sub_shape)) return EXIT_FAILURE;
+    #endif
+
+    tictac(p.generate_mat(&p),"generating problem matrix", mytimer_wall, ti, tf);
+  }
 
   #if EXTRACT_MAT
-  // extracting the problem matrix to 3 files in ./compare_mat
-  if(p.extract_mat(&p)) {printf("failed to open files to extract matrix\n"); return EXIT_FAILURE;}
+  // extracting the problem matrix to EXTRACT_MAT_FILE
+  tic(mytimer_wall, ti);
+  if(p.extract_mat(&p)) {printf("failed to extract matrix\n"); return EXIT_FAILURE;}
+  tac(mytimer_wall, tf, "extracting problem matrix");
   #endif
 
-  printf("m = %5d   n = %8d  nnz = %9d\n", m, p.n, p.ia[p.n] );
+  printf("m = %5d   n = %8d  nnz = %9lld\n", m, p.n, (long long)p.ia[p.n] );
   vspace;
   
   /* allocate memory for vectors & eigenvalues */
   min_evals = (double*)malloc(sizeof(double));
   max_evals = (double*)malloc(sizeof(double));
-  min_evecs = (double*)malloc(p.n * sizeof(double));
-  max_evecs = (double*)malloc(p.n * sizeof(double));
+  min_evecs = problem_vector(&p, "min_evec");
+  max_evecs = problem_vector(&p, "max_evec");
 
   if (min_evals == NULL || max_evals == NULL || min_evecs == NULL || max_evecs == NULL) {
       printf("\n ERREUR : pas assez de mémoire pour les vecteurs et valeurs propres\n\n");
@@ -66,17 +162,62 @@ int main(int argc, char *argv[])
   }
   #endif
 
+  bool restart = false; // ./executable_to_wrap --restart resumes the heat loop from CHECKPOINT_FILE
+  #if CHECKPOINT_EVERY && SHOW_TEMPERATURE_EVOL
+  restart = argc > 1 && strcmp(argv[1], "--restart") == 0;
+  checkpoint ck; if (init_checkpoint(&ck, CHECKPOINT_FILE, &p)) return EXIT_FAILURE;
+  if (restart && ck.read(&ck, NULL, NULL)) return EXIT_FAILURE;
+  #endif
+
   /* primme solver */
   broadcast("solving with primme");
-  init_primme(p.n, p.ia, p.ja, p.a);
-  if(primme(min_evals, min_evecs, max_evals, max_evecs))
+  if (init_primme(p.n, p.ia, p.ja, p.a)) return EXIT_FAILURE;
+  #if KERNEL_LIBRARY && KERNEL_VARIANT == KERNEL_STENCIL
+  kernels_grid(&p);
+  #endif
+  #if STENCIL_9PT
+  if (init_primme_generalized(&p)) return EXIT_FAILURE;
+  #elif PRIMME_SHIFT_INVERT
+  if (init_primme_shift_invert(&p, SHIFT_INVERT_SIGMA)) return EXIT_FAILURE;
+  #elif FAST_POISSON_PRECOND
+  if (init_primme_precond(&p)) return EXIT_FAILURE;
+  #endif
+  #if MIXED_PRECISION
+  if (init_primme_float(&p)) return EXIT_FAILURE;
+  #endif
+  /* minimal eigenvalue with the backend of EIGEN_SOLVER (primme, slepc or the native lobpcg) */
+  solver_stats ss;
+  if (solver_lowest(&p, EIGEN_SOLVER, 1, min_evals, min_evecs, &ss))
      return EXIT_FAILURE;
+  solver_print(&ss);
+  vspace;
+
+  #if SPECTRAL_BOUND
+  if (!restart) {
+    broadcast("bounding the maximal eigenvalue with lanczos");
+    spectral_bound sb;
+    tictac(if (lanczos_bound(&p, LANCZOS_STEPS, LANCZOS_SAFETY, &sb)) return EXIT_FAILURE,
+           "lanczos spectral bound", mytimer_wall, ti, tf);
+    printf("gershgorin bound : %e, ritz value : %e, residual : %e\n", sb.gershgorin, sb.ritz, sb.residual);
+    printf("%e <= max eigen value <= %e (relative gap : %e)\n", sb.ritz, sb.bound, sb.gap);
+    max_evals[0] = sb.bound;
+  }
+  #else
+  if(!restart && primme(NULL, NULL, max_evals, max_evecs))
+     return EXIT_FAILURE;
+  #endif
+  #if CHECKPOINT_EVERY && SHOW_TEMPERATURE_EVOL
+  if (restart) {
+    max_evals[0] = ck.state.lambda_max;
+    printf("max eigen value read from the checkpoint : %e\n", max_evals[0]);
+  }
+  #endif
   vspace;
 
   /* alternative solver : slepc with blopex */
   #if SOLVING_WITH_SLEPC
   broadcast("solving with slepc for minimal eigenvalue");
-  if (slepc(&p, slepc_evals, slepc_evecs)) printf("slepc failed\n");
+  if (slepc(&p, slepc_evals, slepc_evecs, NULL)) printf("slepc failed\n");
   vspace;
   broadcast("comparing eigenvectors and eigenvalues from primme and slepc")
   double compare_vectors = compare_vecs(min_evecs, slepc_evecs, p.n);
@@ -116,19 +257,17 @@ int main(int argc, char *argv[])
   char hp_config[] = "set palette rgb 33,13,10\nset cbrange [0:10]";
   gnuplot hp; init_gnuplot(&hp, hp_config, hp_plotcmd, &p);
 
-  double *uk = (double*)malloc(sizeof(double) * p.n);
+  double *uk = problem_vector(&p, "uk");
   for (int i = 0; i < p.n; i++) {
     uk[i] = INITIAL_TEMP;
   }
   char title[64]; // will be used to display the time on top of the graph
-  double *vk = (double*)malloc(sizeof(double) * p.n); // array to store the product A*uk
+  double *vk = problem_vector(&p, "vk"); // array to store the product A*uk (B^-1 A uk with 9 points)
   double t = 0;
 
   signal(SIGTERM, gnuplot_loop_handler);
   /* sigterm can be send by the wrapper program or by any task manger */
 
-  int blockSize = 1; // needed for matvec_primme to work
-
   double dt_max = 2.0 / (max_evals[0]*DIFFUSIVITY);
   double dt = dt_max / DT_F;
   int tt = TOTAL_TIME;
@@ -137,47 +276,184 @@ int main(int argc, char *argv[])
   int out_loop_tt = ceil(tti/isr);
   printf("dt max for guaranteed convergence of time evolution : %fs\n", dt_max);
 
-  for (int i = 0; i < out_loop_tt; i++) {
+  #if RKC_INTEGRATOR
+  /* frames are kept at the same times as with the euler method, the RKC steps in between are adaptive */
+  rkc rk; if (init_rkc(&rk, p.n, max_evals[0]*DIFFUSIVITY, RKC_TOL, dt_max, matvec_operator)) return EXIT_FAILURE;
+  #elif IMPLICIT_EULER
+  /* the same time step for every step between two frames, so that I + dt D A is only factored once */
+  int implicit_steps = ceil(isr*dt / IMPLICIT_DT);
+  double implicit_dt = isr*dt / implicit_steps;
+  printf("backward euler : %d steps of %gs between two frames\n", implicit_steps, implicit_dt);
+  #endif
+  int matvecs = 0;
+  double step_time = 0; // time spent in the time stepping only, without gnuplot
+  heat_monitor hm; if (init_heat_monitor(&hm, p.n, STEADY_STATE_TOL, FRAME_TOL, uk)) return EXIT_FAILURE;
+  bool steady = false;
+  int frame0 = 0;
+  #if CHECKPOINT_EVERY
+  #if RKC_INTEGRATOR
+  rkc *ck_rk = &rk;
+  #else
+  rkc *ck_rk = NULL;
+  #endif
+  if (restart) {
+    if (ck.read(&ck, uk, hm.last_frame)) return EXIT_FAILURE;
+    frame0 = ck.state.frame;
+    t = ck.state.t;
+    matvecs = ck.state.matvecs;
+    step_time = ck.state.step_time;
+    hm.frames = ck.state.frames;
+    hm.skipped = ck.state.skipped;
+    hm.rate = ck.state.rate;
+    #if RKC_INTEGRATOR
+    rk.dt = ck.state.dt;
+    rk.matvecs = ck.state.matvecs;
+    rk.steps = ck.state.steps;
+    rk.rejected = ck.state.rejected;
+    rk.max_stages = ck.state.max_stages;
+    #endif
+    printf("heat evolution restarted from %s at t = %g s (frame %d)\n", CHECKPOINT_FILE, t, frame0);
+  }
+  #endif
+
+  for (int i = frame0; i < out_loop_tt; i++) {
     if (running == false) {
       printf(ANSI_COLOR_GREEN "\nSIGTERM detected, closing gnuplot pipe safely, terminate program\n" ANSI_COLOR_RESET);
+      #if CHECKPOINT_EVERY
+      checkpoint_state state = heat_state(&ck, i, t, max_evals[0], ck_rk, &hm, matvecs, step_time);
+      if (ck.write(&ck, state, uk, hm.last_frame) == EXIT_SUCCESS && ck.wait(&ck) == EXIT_SUCCESS)
+        printf("state saved to %s, run with --restart to resume\n", CHECKPOINT_FILE);
+      #endif
       goto stop_heat_loop;
     }
 
+    tic(mytimer_wall, ti);
+    #if RKC_INTEGRATOR
+    if (rk.advance(&rk, uk, &t, (i+1)*isr*dt)) goto stop_heat_loop;
+    hm.update(&hm, rk.f0, 1.0); // F(uk) = du/dt is left by the last step
+    #elif IMPLICIT_EULER
+    double rate = 0;
+    for (int j = 0; j < implicit_steps; j++) {
+      if ((rate = temperature_implicit(&p, uk, vk, implicit_dt, &t)) < 0) goto stop_heat_loop;
+    }
+    hm.update(&hm, NULL, rate);
+    #else
+    int blockSize = 1; // needed for matvec_operator to work
     for (int j = 0; j < isr-1; j++) {
       // iterations without displaying on gnuplot
-      matvec_primme(uk, vk, &blockSize, NULL);
+      matvec_operator(uk, vk, &blockSize, NULL);
       temperature_iterate(uk, vk, p.n, dt, &t);
     }
 
-    matvec_primme(uk, vk, &blockSize, NULL);
-    temperature_iterate(uk, vk, p.n, dt, &t);
+    matvec_operator(uk, vk, &blockSize, NULL);
+    hm.update(&hm, NULL, temperature_iterate(uk, vk, p.n, dt, &t));
+    matvecs += isr;
+    #endif
+    step_time += mytimer_wall() - ti;
+    steady = hm.steady(&hm);
+
+    /* a frame is only emitted if the field visibly changed since the last one, or for the last state */
+    if (hm.emit(&hm, uk, steady || i == out_loop_tt-1)) {
+      /* generating title */
+      sprintf(title, "time : %g s", t); 
 
-    /* generating title */
-    sprintf(title, "time : %g s", t); 
+      hp.open(&hp, &p, title);
+      hp.write(&hp, &p, uk);
+    }
+
+    if (steady) {
+      printf("steady state reached at t = %g s (rms of du/dt : %e)\n", t, hm.rate);
+      break;
+    }
 
-    hp.open(&hp, &p, title);
-    hp.write(&hp, &p, uk);
+    #if CHECKPOINT_EVERY
+    /* written by a thread while the next frames are computed */
+    if ((i+1) % CHECKPOINT_EVERY == 0) {
+      ck.write(&ck, heat_state(&ck, i+1, t, max_evals[0], ck_rk, &hm, matvecs, step_time), uk, hm.last_frame);
+    }
+    #endif
   }
 
   stop_heat_loop:
+  #if CHECKPOINT_EVERY
+  ck.close(&ck);
+  #endif
 
   hp.close(&hp);
 
-  free(vk); free(uk);
+  #if RKC_INTEGRATOR
+  matvecs = rk.matvecs;
+  printf("RKC : %d steps, %d rejected, up to %d stages\n", rk.steps, rk.rejected, rk.max_stages);
+  rk.close(&rk);
+  #endif
+  double u_max = 0;
+  for (int i = 0; i < p.n; i++) u_max = fmax(u_max, uk[i]);
+  printf("-> time taken for time stepping was %e seconds (%d matvecs)\n", step_time, matvecs);
+  printf("max temperature at t = %g s : %e\n", t, u_max);
+  printf("%d frames emitted, %d skipped\n", hm.frames, hm.skipped);
+  hm.close(&hm);
+
+  problem_vector_free(&p, vk); problem_vector_free(&p, uk);
 
   vspace;
   #endif /*SHOW_TEMPERATURE_EVOL*/
 
+  #if ENSEMBLE_MODE
+  broadcast("showing heat evolution of the ensemble")
+  double ens_d[ENSEMBLE_SIZE] = ENSEMBLE_DIFFUSIVITY;
+  double ens_u0[ENSEMBLE_SIZE] = ENSEMBLE_INITIAL_TEMP;
+  ensemble ens;
+  if (init_ensemble(&ens, p.n, ENSEMBLE_SIZE, ens_d, ens_u0, max_evals[0], DT_F, TOTAL_TIME)) return EXIT_FAILURE;
+
+  /* one gnuplot window per member */
+  char ens_plotcmd[] = "plot '-' using 1:2:3 with image";
+  char ens_config[64], ens_title[64];
+  gnuplot ens_hp[ENSEMBLE_SIZE];
+  for (int b = 0; b < ENSEMBLE_SIZE; b++) {
+    sprintf(ens_config, "set palette rgb 33,13,10\nset cbrange [0:%g]", ens_u0[b]);
+    init_gnuplot(&ens_hp[b], ens_config, ens_plotcmd, &p);
+  }
+  double *ens_u = (double*)malloc(sizeof(double) * p.n); // contiguous copy of one member for gnuplot
+  if (ens_u == NULL) return EXIT_FAILURE;
+
+  signal(SIGTERM, gnuplot_loop_handler);
+
+  int active = ENSEMBLE_SIZE;
+  double ens_time = 0;
+  while (active > 0 && running) {
+    tic(mytimer_wall, ti);
+    for (int j = 0; j < ISR && active > 0; j++) active = ens.step(&ens);
+    ens_time += mytimer_wall() - ti;
+
+    for (int b = 0; b < ENSEMBLE_SIZE; b++) {
+      ens.extract(&ens, b, ens_u);
+      sprintf(ens_title, "member %d, time : %g s", b, ens.t[b]);
+      ens_hp[b].open(&ens_hp[b], &p, ens_title);
+      ens_hp[b].write(&ens_hp[b], &p, ens_u);
+    }
+  }
+  if (!running) printf(ANSI_COLOR_GREEN "\nSIGTERM detected, closing gnuplot pipes safely\n" ANSI_COLOR_RESET);
+
+  printf("-> time taken for ensemble stepping was %e seconds (%d steps of %d members, %e s per member step)\n",
+         ens_time, ens.steps, ENSEMBLE_SIZE, ens_time / ((double)ens.steps * ENSEMBLE_SIZE));
+  for (int b = 0; b < ENSEMBLE_SIZE; b++) ens_hp[b].close(&ens_hp[b]);
+  free(ens_u);
+  ens.close(&ens);
+  vspace;
+  #endif /*ENSEMBLE_MODE*/
+
 
   /* freeing memory */
   free(min_evals); free(max_evals);
-  free(min_evecs); free(max_evecs);
+  problem_vector_free(&p, min_evecs); problem_vector_free(&p, max_evecs);
 
   #if SOLVING_WITH_SLEPC
   free(slepc_evals); free(slepc_evecs);
   #endif
+  slepc_finalize();
 
   p.close(&p);
+  arena_trim();
 
   printf("program ended, press ENTER to exit\n");
 
@@ -3,6 +3,12 @@
 #include <stdlib.h>
 #include <math.h>
 #include "interface_primme.h"
+#include "cholesky.h"
+#include "fastpoisson.h"
+#include "config.h"
+#include "kernels.h"
+#include "storage.h"
+#include "csrfile.h"
 #define square(x) (x)*(x)
 
 /// @brief initializes a rectangle object
@@ -42,27 +48,25 @@ int in_zone(Rectangle *is, int ix, int iy) {
     return false;
 }
 
+/// @brief numbers the unknowns of the grid in the inds array, -1 for the points of the hole
+/// @return the number of unknowns
+int generate_inds(problem *s) {
+    int ind = 0;
+    for (int u = 0; u < s->nx * s->ny; u++) {
+        s->inds[u] = in_zone(&s->i_s, u % s->nx, u / s->nx) ? -1 : ind++;
+    }
+    return ind;
+}
+
 /// @brief generates the problem matrix with the help of an array to hold offset indices
 /// to take into account the wall
 /// @return integer for error handling
 int generate_mat(problem *s) {
     int ind = 0;
-    int u = 0;
     int *inds = s->inds;
     double invh2 = (s->m-1)*(s->m-1); // for unit lenght
     
-    for (int iy = 0; iy < s->ny; iy++) {
-        for (int ix = 0; ix < s->nx; ix++) {
-            if (in_zone(&s->i_s,ix,iy)) {
-                inds[u] = -1;
-                // this will later indicate that we are in the wall
-            } else {
-                inds[u] = ind;
-                ind ++;
-            }
-            u++;
-        }
-    }
+    generate_inds(s);
 
     /*
         the inds array makes it easy to keep the function of the problem without an hole. 
@@ -70,7 +74,7 @@ int generate_mat(problem *s) {
         inds[ind-nx] which gives me the right place in the matrix taking the hole into account
     */
 
-    int nnz = 0;
+    csr_off nnz = 0;
     ind = 0;
     for (int iy = 0; iy < s->ny; iy++) {
         for (int ix = 0; ix < s->nx; ix++) {
@@ -118,6 +122,47 @@ int generate_mat(problem *s) {
     return EXIT_SUCCESS;
 }
 
+/// @brief generates the compact fourth order (Mehrstellen) discretization of -laplacian(u) = lambda u :
+/// A = 1/(6h^2) [-1 -4 -1; -4 20 -4; -1 -4 -1] and B = 1/12 [0 1 0; 1 8 1; 0 1 0], both stored in the
+/// same CSR pattern (s->a and s->b). The hole nodes and the outer boundary hold u = 0, the couplings to them
+/// are dropped as in generate_mat, this includes the diagonal neighbors across the corners of the hole.
+/// @return integer for error handling
+int generate_mat_9pt(problem *s) {
+    int ind = 0;
+    int *inds = s->inds;
+    double invh2 = (s->m-1)*(s->m-1); // for unit lenght
+    double wa[3][3] = {{-invh2/6, -4*invh2/6, -invh2/6}, {-4*invh2/6, 20*invh2/6, -4*invh2/6}, {-invh2/6, -4*invh2/6, -invh2/6}};
+    double wb[3][3] = {{0, 1.0/12, 0}, {1.0/12, 8.0/12, 1.0/12}, {0, 1.0/12, 0}};
+
+    generate_inds(s);
+
+    /* rows are filled from south-west to north-east so that the columns stay sorted */
+    csr_off nnz = 0;
+    for (int iy = 0; iy < s->ny; iy++) {
+        for (int ix = 0; ix < s->nx; ix++) {
+            ind = ix + s->nx * iy;
+            if (inds[ind] == -1) continue;
+            s->ia[inds[ind]] = nnz;
+            for (int dy = -1; dy <= 1; dy++) {
+                if (iy + dy < 0 || iy + dy >= s->ny) continue;
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (ix + dx < 0 || ix + dx >= s->nx) continue;
+                    int nb = inds[ind + dx + s->nx * dy];
+                    if (nb == -1) continue;
+                    s->a[nnz] = wa[dy+1][dx+1];
+                    s->b[nnz] = wb[dy+1][dx+1];
+                    s->ja[nnz] = nb;
+                    nnz++;
+                }
+            }
+        }
+    }
+    s->ia[s->n] = nnz;
+    s->nnz = nnz;
+
+    return EXIT_SUCCESS;
+}
+
 /// @brief Calculates ||u-v||/||u|| using the euclidian norm
 /// @param u should be the vector found by primme
 /// @param v the vector to compare with
@@ -126,6 +171,9 @@ int generate_mat(problem *s) {
 /// @attention the absolute value of the vector elements are taken
 double compare_vecs(double *u, double *v, int n) 
 {
+    #if KERNEL_LIBRARY
+    return kernel_compare(u, v, n);
+    #endif
     double umv_buf = 0;
     double u_buf = 0;
     for (int i = 0; i < n; i ++) {
@@ -138,20 +186,25 @@ double compare_vecs(double *u, double *v, int n)
 }
 
 /// @brief Calculing the norm of the residual from A u = w2 u with the formula ||A u - w2 u||/||u|| using euclidian norm
+/// (||A u - w2 B u||/||u|| for the 9 point stencil)
 /// @param u the calculated eigen vec 
 /// @param w2 the calculated eigen value
 /// @return the norm of the residual
 double calc_res(problem *s, double *u, double w2) {
+    #if KERNEL_LIBRARY
+    if (s->b == NULL) return kernel_residual(s, u, w2);
+    #endif
     double result = 0;
     double u_norm2 = 0;
-    int ia_buf = 0; // ia[0] == 0 is always true
+    csr_off ia_buf = 0; // ia[0] == 0 is always true
 
     double line_result;
     for (int i = 0; i < s->n; i++) {
-        line_result = -w2*u[i];
+        line_result = (s->b == NULL) ? -w2*u[i] : 0;
         u_norm2 += square(u[i]);
-        for (int j = ia_buf; j < (ia_buf= s->ia[i+1]); j++) {
+        for (csr_off j = ia_buf; j < (ia_buf= s->ia[i+1]); j++) {
             line_result += s->a[j] * u[s->ja[j]];
+            if (s->b != NULL) line_result -= w2 * s->b[j] * u[s->ja[j]];
         }
         result += square(line_result);
     }
@@ -159,46 +212,66 @@ double calc_res(problem *s, double *u, double w2) {
     return sqrt(result);
 }
 
-/// @brief Creates 3 files to extract the CSR matrix
+/// @brief writes the CSR matrix to EXTRACT_MAT_FILE (binary container, compared with ./csrdiff), and to the
+/// Matrix Market file EXTRACT_MAT_MARKET with EXTRACT_MAT 2
 /// @return integer for error handling
 int extract_mat(problem *s) {
     line_sep;
-    FILE *pia, *pja, *pa;
-    pia = fopen("./compare_mat/ia_gen.txt","w");
-    pja = fopen("./compare_mat/ja_gen.txt","w");
-    pa = fopen("./compare_mat/a_gen.txt","w");
-    if(pia == NULL || pja == NULL || pa == NULL) return EXIT_FAILURE;
-    int nnz = s->ia[s->n]-s->ia[0];
-    for (int i = 0; i < s->n + 1; i++) {
-        fprintf(pia,"%i\n", s->ia[i]);
-    }
-    for (int i = 0; i < nnz; i++) {
-        fprintf(pja, "%i\n", s->ja[i]);
-    }
-    for (int i = 0; i < nnz; i++) {
-        fprintf(pa, "%.15lf\n", s->a[i]);
-    }
-    fclose(pia); fclose(pja); fclose(pa);
+    if (csr_save(s, EXTRACT_MAT_FILE)) return EXIT_FAILURE;
+    #if EXTRACT_MAT == 2
+    if (csr_market(s, s->a, EXTRACT_MAT_MARKET)) return EXIT_FAILURE;
+    #endif
     return EXIT_SUCCESS;
 }
 
 /// @brief frees all heap allocated memory for problem object
 void remove_problem(problem *s) {
-    free(s->ia);
-    free(s->ja);
-    free(s->a);
+    cholesky_forget(s);
+    fastpoisson_forget(s);
+    free(s->shifted);
+    #if ARENA_ALLOCATOR
+    s->mem.close(&s->mem);
+    #else
+    storage_free(s->ia);
+    storage_free(s->ja);
+    storage_free(s->a);
+    storage_free(s->b);
     free(s->inds);
+    #endif
 }
 
-/// @brief Initializes the problem object
+/// @brief array of the problem : from its arena, otherwise from storage_alloc() (file-backed with LARGE_GRID)
+static void *problem_array(problem *s, size_t bytes, const char *name) {
+    #if ARENA_ALLOCATOR
+    return s->mem.alloc(&s->mem, bytes);
+    #else
+    return storage_alloc(bytes, name);
+    #endif
+}
+
+/// @brief allocates a vector of n doubles for the problem (eigenvector, temperature field...),
+/// in its arena with ARENA_ALLOCATOR (ARENA_VECTORS of them at most)
+/// @param name used for the backing file with LARGE_GRID
+/// @return the vector, NULL if there is not enough memory
+double *problem_vector(problem *s, const char *name) {
+    return (double*)problem_array(s, s->n * sizeof(double), name);
+}
+
+/// @brief frees a vector of problem_vector(), nothing to do with the arena which is released by p.close
+void problem_vector_free(problem *s, double *v) {
+    #if !ARENA_ALLOCATOR
+    storage_free(v);
+    #endif
+}
+
+/// @brief Initializes the problem object with a hole given in grid indices, it can then sit on any grid line
 /// @param self The yet unitialized object
 /// @param m The number of grid point for the unit lenght
 /// @param shape The shape of the membrane
-/// @param sub_shape The shape of the hole
+/// @param hole The hole in the grid coordinates system (first and last index of the hole points in x and y)
 /// @return integer for error handling
-/// @attention This program will not work for holes that overlap the boundary of the membrane,
-/// they should be stricly contained inside
-int init_problem(problem *self, int m, pos2d shape, Rectangle sub_shape) {
+/// @attention the hole has to leave at least one row of unknowns to the boundary of the membrane
+int init_problem_grid(problem *self, int m, pos2d shape, Rectangle hole) {
     /* struct for storage of problem data, makes
      passing problem data in function arguments easier */
 
@@ -210,30 +283,73 @@ int init_problem(problem *self, int m, pos2d shape, Rectangle sub_shape) {
     self->ny = shape.y * (m-1) - 1;
 
     // sub shape (hole)
-    self->s_s = sub_shape;
-    self->i_s = get_sub_shape_indices(&self->s_s, m);
-    int nx_is = (self->s_s.x[1]-self->s_s.x[0])*(m-1)+1; 
-    int ny_is = (self->s_s.y[1]-self->s_s.y[0])*(m-1)+1; 
+    if (hole.x[0] < 1 || hole.x[1] > self->nx - 2 || hole.x[0] > hole.x[1]
+        || hole.y[0] < 1 || hole.y[1] > self->ny - 2 || hole.y[0] > hole.y[1]) {
+        printf("\n ERROR : the hole [%d, %d] x [%d, %d] is not strictly inside the grid\n\n",
+               hole.x[0], hole.x[1], hole.y[0], hole.y[1]);
+        return EXIT_FAILURE;
+    }
+    init_rectangle(&self->s_s, 0, 0, 0, 0); // only known in units of the membrane with init_problem
+    self->i_s = hole;
+    int nx_is = hole.x[1] - hole.x[0] + 1;
+    int ny_is = hole.y[1] - hole.y[0] + 1;
     self->nx_is = nx_is;
     self->ny_is = ny_is;
 
     /* allocations */
-    self->inds = (int*)malloc(sizeof(int) * self->nx*self->ny);
+    self->shifted = NULL;
     self->n = self->nx * self->ny - nx_is * ny_is;
-    self->ia = (int*)malloc(((self->n)+1) * sizeof(int));
-    // number of non-zero elements
-    int nnz = 5 * self->nx * self->ny- 2*self->nx - 2*self->ny - 2*nx_is -2*ny_is;
-    self->ja = (int*)malloc(nnz * sizeof(int));
-    self->a = (double*)malloc(nnz * sizeof(double));
-    if (self->inds == NULL || self->ia == NULL || self->ja == NULL || self->a == NULL ) {
+    // number of non-zero elements (computed with csr_off, it goes beyond 2^31 before n does)
+    #if STENCIL_9PT
+    csr_off nnz = (csr_off)9 * self->n; // upper bound, the exact count is known after generate_mat_9pt
+    #else
+    csr_off nnz = (csr_off)5 * self->nx * self->ny - 2*self->nx - 2*self->ny - 2*nx_is -2*ny_is;
+    #endif
+    self->nnz = nnz;
+    #if ARENA_ALLOCATOR
+    size_t bytes = arena_bytes(sizeof(int) * self->nx*self->ny) + arena_bytes((self->n+1) * sizeof(csr_off))
+                 + arena_bytes(nnz * sizeof(int)) + (1 + STENCIL_9PT) * arena_bytes(nnz * sizeof(double))
+                 + ARENA_VECTORS * arena_bytes(self->n * sizeof(double));
+    if (init_arena(&self->mem, bytes)) return EXIT_FAILURE;
+    self->inds = (int*)self->mem.alloc(&self->mem, sizeof(int) * self->nx*self->ny);
+    #else
+    self->inds = (int*)malloc(sizeof(int) * self->nx*self->ny);
+    #endif
+    self->ia = (csr_off*)problem_array(self, ((self->n)+1) * sizeof(csr_off), "ia");
+    #if STENCIL_9PT
+    self->b = (double*)problem_array(self, nnz * sizeof(double), "b");
+    #else
+    self->b = NULL;
+    #endif
+    self->ja = (int*)problem_array(self, nnz * sizeof(int), "ja");
+    self->a = (double*)problem_array(self, nnz * sizeof(double), "a");
+    if (self->inds == NULL || self->ia == NULL || self->ja == NULL || self->a == NULL || (STENCIL_9PT && self->b == NULL)) {
         printf("\n ERROR : not enough memory to generate the matrix\n\n");
         return EXIT_FAILURE;
     }
     
     // function pointers
+    #if STENCIL_9PT
+    self->generate_mat = generate_mat_9pt;
+    #else
     self->generate_mat = generate_mat;
+    #endif
     self->close = remove_problem;
     self->extract_mat = extract_mat;
 
     return EXIT_SUCCESS;
 }
+
+/// @brief Initializes the problem object
+/// @param self The yet unitialized object
+/// @param m The number of grid point for the unit lenght
+/// @param shape The shape of the membrane
+/// @param sub_shape The shape of the hole
+/// @return integer for error handling
+/// @attention This program will not work for holes that overlap the boundary of the membrane,
+/// they should be stricly contained inside
+int init_problem(problem *self, int m, pos2d shape, Rectangle sub_shape) {
+    if (init_problem_grid(self, m, shape, get_sub_shape_indices(&sub_shape, m))) return EXIT_FAILURE;
+    self->s_s = sub_shape;
+    return EXIT_SUCCESS;
+}
@@ -3,12 +3,21 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include "config.h"
+#include "arena.h"
 #define line_sep printf("\n--------------------------------\n")
 
 typedef struct {
     int x,y;
 } pos2d;
 
+/* offsets of the CSR rows (ia, nnz) : 64 bit for the large grids, the columns (ja) and the unknowns stay int */
+#if LARGE_GRID
+typedef long long csr_off;
+#else
+typedef int csr_off;
+#endif
+
 typedef struct sRectangle Rectangle;
 struct sRectangle {
     int x[2];
@@ -23,19 +32,30 @@ typedef struct sProblem problem;
 
 struct sProblem {
     pos2d m_s; // main shape
-    Rectangle s_s; // sub shape
+    Rectangle s_s; // sub shape (units of the membrane, zero for a hole placed with init_problem_grid)
     Rectangle i_s; // sub shape (index data)
-    int *ia, *ja;
+    csr_off *ia, nnz;
+    int *ja;
     double *a;
+    double *b; // mass matrix of the 9 point stencil (A u = lambda B u), same pattern as a, NULL for 5 points
+    double *shifted; // values of A + B/(dt D) for the backward euler steps of the 9 point stencil, NULL until the first one
+    double shifted_dt; // dt D of these values
     int *inds; // indices for each point the the grid, -1 to indicate the hole
-    int m, n, nnz, nx, ny;
+    int m, n, nx, ny;
     int nx_is, ny_is;
+    arena mem; // holds all the arrays with ARENA_ALLOCATOR
     int (*generate_mat)(problem*);
     void (*close)(problem*);
     int (*extract_mat)(problem*);
 };
 
 int init_problem(problem* self, int m, pos2d shape, Rectangle sub_shape);
+int init_problem_grid(problem *self, int m, pos2d shape, Rectangle hole);
+
+int generate_inds(problem *s);
+
+double *problem_vector(problem *s, const char *name);
+void problem_vector_free(problem *s, double *v);
 
 double calc_res(problem *s, double *u, double w2);
 double compare_vecs(double* u, double* v, int n);
@@ -0,0 +1,124 @@
+#include "richardson.h"
+#include "interface_primme.h"
+#include "kernels.h"
+#include <stdlib.h>
+#include <math.h>
+#include "config.h"
+#include "time.h"
+
+/// @brief value of the coarse field at the coarse grid point (jx, jy), 0 on the boundary and in the hole
+static double coarse_value(problem *c, double *uc, int jx, int jy) {
+    if (jx < 0 || jx >= c->nx || jy < 0 || jy >= c->ny) return 0;
+    int ind = c->inds[jx + c->nx * jy];
+    return (ind == -1) ? 0 : uc[ind];
+}
+
+/// @brief Bilinear interpolation of a field from a grid to the one with half the step (m-1 doubled) :
+/// the fine point (ix, iy) is at ((ix+1) h, (iy+1) h), the coarse point (jx, jy) at fine point (2jx+1, 2jy+1)
+/// @param coarse the problem of the coarse grid (its inds array has to be filled by generate_mat)
+/// @param uc field on the coarse grid
+/// @param fine the problem of the fine grid
+/// @param uf interpolated field on the fine grid
+void prolongate(problem *coarse, double *uc, problem *fine, double *uf) {
+    for (int iy = 0; iy < fine->ny; iy++) {
+        /* coarse lines around the fine one and their weights */
+        int y0 = (iy+1)/2 - 1, y1 = (iy+1) % 2 ? y0 + 1 : y0;
+        double wy = (iy+1) % 2 ? 0.5 : 1.0;
+        for (int ix = 0; ix < fine->nx; ix++) {
+            int ind = fine->inds[ix + fine->nx * iy];
+            if (ind == -1) continue;
+            int x0 = (ix+1)/2 - 1, x1 = (ix+1) % 2 ? x0 + 1 : x0;
+            double wx = (ix+1) % 2 ? 0.5 : 1.0;
+            double v = coarse_value(coarse, uc, x0, y0);
+            if (x1 != x0) v += coarse_value(coarse, uc, x1, y0);
+            if (y1 != y0) {
+                v += coarse_value(coarse, uc, x0, y1);
+                if (x1 != x0) v += coarse_value(coarse, uc, x1, y1);
+            }
+            uf[ind] = wx * wy * v;
+        }
+    }
+}
+
+/// @brief Solves for the minimal eigenvalue on the grids m_k = (m0-1) 2^k + 1, k = 0 .. levels-1, and
+/// extrapolates the sequence to h = 0. The hole is given in units of the membrane so its edges are grid
+/// lines of every level. Each solve starts from the prolongated eigenvector of the previous level.
+/// @param shape the shape of the membrane
+/// @param sub_shape the shape of the hole
+/// @param m0 number of grid points for the unit lenght on the coarsest grid
+/// @param levels number of grids (3 to RICHARDSON_MAX_LEVELS), the order is estimated from the last three
+/// @param res holds the eigenvalues of every level and the extrapolation
+/// @return integer for error handling
+/// @note with lambda(h) = lambda + C h^p, p = log2((l[k-2]-l[k-1])/(l[k-1]-l[k])) and
+///       lambda ~ l[k] + (l[k]-l[k-1])/(2^p-1). The error bar is the change of this extrapolation
+///       when the finest level is dropped (the last correction l[k]-lambda with only three levels)
+int richardson(pos2d shape, Rectangle sub_shape, int m0, int levels, richardson_result *res) {
+    double ti, tf;
+    problem p[2];
+    double *u[2] = {NULL, NULL};
+
+    if (levels < 3 || levels > RICHARDSON_MAX_LEVELS) {
+        printf("\n ERROR : richardson extrapolation needs 3 to %d levels\n\n", RICHARDSON_MAX_LEVELS);
+        return EXIT_FAILURE;
+    }
+    res->levels = levels;
+
+    for (int k = 0; k < levels; k++) {
+        int cur = k % 2, prev = 1 - cur;
+        int m = (m0-1) * (1 << k) + 1;
+        if (init_problem(&p[cur], m, shape, sub_shape)) return EXIT_FAILURE;
+        p[cur].generate_mat(&p[cur]);
+        u[cur] = problem_vector(&p[cur], "evec");
+        if (u[cur] == NULL) {
+            printf("\n ERROR : not enough memory for the eigenvector of level %d\n\n", k);
+            return EXIT_FAILURE;
+        }
+
+        if (init_primme(p[cur].n, p[cur].ia, p[cur].ja, p[cur].a)) return EXIT_FAILURE;
+        #if KERNEL_LIBRARY && KERNEL_VARIANT == KERNEL_STENCIL
+        kernels_grid(&p[cur]);
+        #endif
+        #if STENCIL_9PT
+        if (init_primme_generalized(&p[cur])) return EXIT_FAILURE;
+        #elif PRIMME_SHIFT_INVERT
+        if (init_primme_shift_invert(&p[cur], SHIFT_INVERT_SIGMA)) return EXIT_FAILURE;
+        #elif FAST_POISSON_PRECOND
+        if (init_primme_precond(&p[cur])) return EXIT_FAILURE;
+        #endif
+
+        tic(mytimer_wall, ti);
+        if (k > 0) {
+            prolongate(&p[prev], u[prev], &p[cur], u[cur]);
+            problem_vector_free(&p[prev], u[prev]);
+            p[prev].close(&p[prev]);
+        }
+        if (primme_lowest(&res->lambda[k], u[cur], k > 0)) return EXIT_FAILURE;
+        tf = mytimer_wall();
+
+        res->m[k] = m;
+        res->n[k] = p[cur].n;
+        res->time[k] = tf - ti;
+        printf("richardson level %d : m = %5d   n = %8d   lambda = %.12e   (%e seconds)\n",
+               k, m, p[cur].n, res->lambda[k], res->time[k]);
+    }
+    problem_vector_free(&p[(levels-1) % 2], u[(levels-1) % 2]);
+    p[(levels-1) % 2].close(&p[(levels-1) % 2]);
+
+    /* order and extrapolation from the last three levels */
+    double *l = res->lambda;
+    int k = levels - 1;
+    res->order = log2((l[k-2] - l[k-1]) / (l[k-1] - l[k]));
+    if (!isfinite(res->order)) {
+        printf("\n ERROR : the eigenvalues of the levels are not monotonic, no convergence order\n\n");
+        return EXIT_FAILURE;
+    }
+    double f = pow(2.0, res->order) - 1.0;
+    res->extrapolated = l[k] + (l[k] - l[k-1]) / f;
+    if (levels > 3) {
+        double fp = (l[k-3] - l[k-2]) / (l[k-2] - l[k-1]) - 1.0; // 2^p - 1 of the previous three levels
+        res->error = fabs(res->extrapolated - (l[k-1] + (l[k-1] - l[k-2]) / fp));
+    } else {
+        res->error = fabs(l[k] - res->extrapolated);
+    }
+    return EXIT_SUCCESS;
+}
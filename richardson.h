@@ -0,0 +1,23 @@
+#ifndef RICHARDSON_H
+#define RICHARDSON_H
+
+#include "prob.h"
+
+#define RICHARDSON_MAX_LEVELS 8
+
+typedef struct {
+    int levels;
+    int m[RICHARDSON_MAX_LEVELS]; // m-1 doubles from one level to the next
+    int n[RICHARDSON_MAX_LEVELS];
+    double lambda[RICHARDSON_MAX_LEVELS]; // minimal eigenvalue on each grid
+    double time[RICHARDSON_MAX_LEVELS]; // time of the solve (with the prolongation of the initial guess)
+    double order; // estimated convergence order p, lambda(h) = lambda + C h^p
+    double extrapolated; // richardson extrapolation from the last two levels with order p
+    double error; // error bar : change of the extrapolation when the finest level is dropped
+} richardson_result;
+
+void prolongate(problem *coarse, double *uc, problem *fine, double *uf);
+
+int richardson(pos2d shape, Rectangle sub_shape, int m0, int levels, richardson_result *res);
+
+#endif // !RICHARDSON_H
@@ -0,0 +1,141 @@
+#include "solver.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "config.h"
+#include "time.h"
+#include "interface_primme.h"
+#include "interface_slepc.h"
+#include "fastpoisson.h"
+#include "spectral.h"
+#include "lobpcg.h"
+
+static const char *names[3] = {"native lobpcg", "primme", "slepc"};
+
+/// @brief estimated time of a backend from the latest recorded solve with the closest n and nev (in log scale),
+/// scaled by (n/n_rec)^1.5 (matvecs times the iterations that grow like m) and by nev/nev_rec
+/// @return the estimation in seconds, negative if the backend has no record
+static double history_estimate(int backend, int n, int nev) {
+    if (SOLVER_HISTORY[0] == '\0') return -1;
+    FILE *f = fopen(SOLVER_HISTORY, "r");
+    if (f == NULL) return -1;
+    int b, hn, hnev;
+    double ht, best = -1, dist = INFINITY;
+    while (fscanf(f, "%d %d %d %lf", &b, &hn, &hnev, &ht) == 4) {
+        if (b != backend || hn <= 0 || hnev <= 0) continue;
+        double d = fabs(log((double)n / hn)) + fabs(log((double)nev / hnev));
+        if (d > dist) continue;
+        dist = d;
+        best = ht * pow((double)n / hn, 1.5) * nev / hnev;
+    }
+    fclose(f);
+    return best;
+}
+
+/// @brief appends the timing of a solve to SOLVER_HISTORY, only with the automatic selection (EIGEN_SOLVER -1)
+/// which is the one reading it
+static void history_record(solver_stats *st, int n) {
+    if (EIGEN_SOLVER != SOLVER_AUTO || SOLVER_HISTORY[0] == '\0') return;
+    FILE *f = fopen(SOLVER_HISTORY, "a");
+    if (f == NULL) return;
+    fprintf(f, "%d %d %d %e\n", st->backend, n, st->nev, st->time);
+    fclose(f);
+}
+
+/// @brief solve with the native LOBPCG on the same operator as primme_lowest() : L^-1 A L^-T with the
+/// 9 point stencil, A otherwise, preconditioned by (A - sigma I)^-1 or by the fast poisson solver if they are set
+static int native_lowest(problem *p, int nev, double *evals, double *evecs, solver_stats *st) {
+    lobpcg_params prm;
+    #if STENCIL_9PT
+    lobpcg_default(&prm, p->n, nev, matvec_generalized);
+    #else
+    lobpcg_default(&prm, p->n, nev, matvec_primme);
+    #if PRIMME_SHIFT_INVERT
+    prm.precond = matvec_shift_invert; // factorization of init_primme_shift_invert()
+    #elif FAST_POISSON_PRECOND
+    prm.precond = precond_fastpoisson;
+    prm.precond_ctx = p;
+    #endif
+    #endif
+    prm.tol = LOBPCG_TOL * gershgorin_max(p);
+
+    double *resn = (double*)malloc(nev * sizeof(double));
+    if (resn == NULL) return EXIT_FAILURE;
+    int err = lobpcg(&prm, evals, evecs, resn);
+    #if STENCIL_9PT
+    for (int j = 0; j < nev; j++) generalized_eigvec(evecs + (size_t)j * p->n);
+    #endif
+    st->iterations = prm.iterations;
+    st->matvecs = prm.matvecs;
+    st->preconds = prm.preconds;
+    if (!err) printf("lobpcg : block of %d, minimal eigen value : %e, error : %e\n", prm.block, evals[0], resn[0]);
+    free(resn);
+    return err;
+}
+
+/// @brief chooses the backend of a solve : the fastest one estimated from the timings of the previous
+/// solves if at least two backends have some, otherwise LOBPCG up to SOLVER_NATIVE_N unknowns (no setup,
+/// no copy of the matrix) and primme above. Only LOBPCG is set up for more than one eigenpair
+/// @param n number of unknowns
+/// @param nev number of wanted eigenpairs
+/// @return SOLVER_NATIVE, SOLVER_PRIMME or SOLVER_SLEPC
+int solver_select(int n, int nev) {
+    if (nev > 1) return SOLVER_NATIVE;
+    int known = 0, best = -1;
+    double est[3];
+    for (int b = SOLVER_NATIVE; b <= (LARGE_GRID ? SOLVER_PRIMME : SOLVER_SLEPC); b++) { // slepc copies the matrix in memory
+        est[b] = history_estimate(b, n, nev);
+        if (est[b] < 0) continue;
+        known++;
+        if (best == -1 || est[b] < est[best]) best = b;
+    }
+    if (known >= 2) return best;
+    return (n <= SOLVER_NATIVE_N) ? SOLVER_NATIVE : SOLVER_PRIMME;
+}
+
+/// @brief Solves for the lowest eigenpairs with one of the backends, init_primme() (and the init_primme_*
+/// function of the operator) has to be called beforehand since the native solver uses the same operator
+/// @param p the problem object
+/// @param backend SOLVER_NATIVE, SOLVER_PRIMME, SOLVER_SLEPC or SOLVER_AUTO
+/// @param nev number of eigenpairs, 1 for primme and slepc
+/// @param evals the nev lowest eigenvalues
+/// @param evecs the nev eigenvectors (n x nev, column-major)
+/// @param st statistics of the solve, the timing is added to SOLVER_HISTORY with EIGEN_SOLVER -1
+/// @return integer for error handling
+int solver_lowest(problem *p, int backend, int nev, double *evals, double *evecs, solver_stats *st) {
+    double ti;
+    if (backend == SOLVER_AUTO) {
+        backend = solver_select(p->n, nev);
+        printf("solver selection : %s for n = %d and %d eigenpair(s)\n", names[backend], p->n, nev);
+    }
+    if (backend < SOLVER_NATIVE || backend > SOLVER_SLEPC || (nev > 1 && backend != SOLVER_NATIVE)) {
+        printf("\n ERROR : no eigen solver %d for %d eigenpair(s)\n\n", backend, nev);
+        return EXIT_FAILURE;
+    }
+    memset(st, 0, sizeof(solver_stats));
+    st->backend = backend;
+    st->nev = nev;
+
+    int err = EXIT_FAILURE;
+    tic(mytimer_wall, ti);
+    switch (backend) {
+        case SOLVER_NATIVE: err = native_lowest(p, nev, evals, evecs, st); break;
+        case SOLVER_PRIMME: err = primme(evals, evecs, NULL, NULL); primme_last_stats(st); break;
+        case SOLVER_SLEPC: err = slepc(p, evals, evecs, st); break;
+    }
+    st->time = mytimer_wall() - ti;
+    if (err) return EXIT_FAILURE;
+
+    st->residual = calc_res(p, evecs, evals[0]);
+    history_record(st, p->n);
+    return EXIT_SUCCESS;
+}
+
+/// @brief prints the statistics of a solve, the same for every backend
+void solver_print(solver_stats *st) {
+    printf("%s : %d iterations, %d matvecs, %d preconditioner applications\n",
+           names[st->backend], st->iterations, st->matvecs, st->preconds);
+    printf("-> time taken for the %s solve was %e seconds (setup %e seconds), residual : %e\n",
+           names[st->backend], st->time, st->setup, st->residual);
+}
@@ -0,0 +1,28 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "prob.h"
+
+/* backends of the minimal eigenvalue solve (EIGEN_SOLVER in config.h) */
+#define SOLVER_AUTO -1 // chosen from n, the number of eigenpairs and the timings of the previous runs
+#define SOLVER_NATIVE 0 // lobpcg.c
+#define SOLVER_PRIMME 1
+#define SOLVER_SLEPC 2
+
+/* statistics reported the same way by every backend */
+typedef struct {
+    int backend;
+    int nev;
+    double setup; // seconds before the iterations (slepc initialization and matrix copy)
+    double time; // seconds for the whole solve, setup included
+    int iterations, matvecs, preconds;
+    double residual; // ||A u - lambda u||/||u|| of the lowest pair from calc_res
+} solver_stats;
+
+int solver_select(int n, int nev);
+
+int solver_lowest(problem *p, int backend, int nev, double *evals, double *evecs, solver_stats *st);
+
+void solver_print(solver_stats *st);
+
+#endif // !SOLVER_H
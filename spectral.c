@@ -0,0 +1,156 @@
+#include "spectral.h"
+#include "interface_primme.h"
+#include <math.h>
+#include <stdlib.h>
+#include "config.h"
+#define square(x) (x)*(x)
+
+/// @brief Upper bound of the spectrum given by the Gershgorin circles of the CSR rows
+/// @param s the problem object holding the matrix
+/// @return max over the rows of a_ii + sum |a_ij|, divided by the lower Gershgorin bound
+///         min over the rows of b_ii - sum |b_ij| of the mass matrix if there is one
+double gershgorin_max(problem *s) {
+    double bound = -INFINITY, bmin = INFINITY;
+    for (int i = 0; i < s->n; i++) {
+        double row = 0, brow = 0;
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) {
+            row += (s->ja[j] == i) ? s->a[j] : fabs(s->a[j]);
+            if (s->b != NULL) brow += (s->ja[j] == i) ? s->b[j] : -fabs(s->b[j]);
+        }
+        if (row > bound) bound = row;
+        if (brow < bmin) bmin = brow;
+    }
+    return (s->b != NULL) ? bound / bmin : bound;
+}
+
+/// @brief number of eigenvalues of the tridiagonal matrix (alpha, beta) strictly smaller than x (Sturm sequence)
+static int sturm_count(double *alpha, double *beta, int k, double x) {
+    int count = 0;
+    double q = alpha[0] - x;
+    for (int j = 0; j < k; j++) {
+        if (j > 0) q = alpha[j] - x - square(beta[j-1]) / q;
+        if (q == 0) q = -1e-300; // avoids a division by zero, counted as negative
+        if (q < 0) count++;
+    }
+    return count;
+}
+
+/// @brief largest eigenvalue of the tridiagonal matrix by bisection on the Sturm sequence
+static double tridiag_max(double *alpha, double *beta, int k) {
+    double lo = INFINITY, hi = -INFINITY;
+    for (int j = 0; j < k; j++) {
+        double r = (j > 0 ? fabs(beta[j-1]) : 0) + (j < k-1 ? fabs(beta[j]) : 0);
+        if (alpha[j] - r < lo) lo = alpha[j] - r;
+        if (alpha[j] + r > hi) hi = alpha[j] + r;
+    }
+    // the largest eigenvalue is the one above which no eigenvalue is left
+    for (int it = 0; it < 200 && hi - lo > 1e-15 * fabs(hi); it++) {
+        double mid = 0.5 * (lo + hi);
+        if (sturm_count(alpha, beta, k, mid) == k) hi = mid;
+        else lo = mid;
+    }
+    return hi;
+}
+
+/// @brief last component of the normalized eigenvector of the tridiagonal matrix for eigenvalue theta.
+/// Inverse iteration with a shift slightly above theta : T - shift I is then negative definite
+/// and the Thomas algorithm is stable without pivoting
+static double tridiag_last_component(double *alpha, double *beta, int k, double theta, double *z, double *c) {
+    double shift = theta + 1e-10 * fabs(theta) + 1e-300;
+    for (int j = 0; j < k; j++) z[j] = 1.0;
+    for (int it = 0; it < 3; it++) {
+        /* forward sweep */
+        double d = alpha[0] - shift;
+        c[0] = (k > 1) ? beta[0] / d : 0;
+        z[0] /= d;
+        for (int j = 1; j < k; j++) {
+            d = alpha[j] - shift - beta[j-1] * c[j-1];
+            c[j] = (j < k-1) ? beta[j] / d : 0;
+            z[j] = (z[j] - beta[j-1] * z[j-1]) / d;
+        }
+        /* back substitution */
+        for (int j = k-2; j >= 0; j--) z[j] -= c[j] * z[j+1];
+        double norm = 0;
+        for (int j = 0; j < k; j++) norm += square(z[j]);
+        norm = sqrt(norm);
+        for (int j = 0; j < k; j++) z[j] /= norm;
+    }
+    return z[k-1];
+}
+
+/// @brief Estimates an upper bound of the max eigenvalue of A with a few lanczos steps,
+/// the result is checked against the Gershgorin bound of the CSR rows.
+/// The matrix has to be given to primme beforehand with init_primme() since matvec_primme is used
+/// (matvec_generalized with the 9 point stencil, init_primme_generalized() has to be called too).
+/// @param s the problem object holding the matrix
+/// @param steps number of lanczos steps (one matvec each)
+/// @param safety multiplicative margin (>= 1) applied on the lanczos estimate
+/// @param res holds the bound and the values used to get it
+/// @return integer for error handling
+/// @note the ritz value is a lower bound of the max eigenvalue, ritz + residual is the
+///       upper bound from Zhou & Li (2006) which only fails if lanczos missed the top of the
+///       spectrum : safety covers this case and the bound never exceeds the Gershgorin one
+int lanczos_bound(problem *s, int steps, double safety, spectral_bound *res) {
+    int n = s->n;
+    int blockSize = 1;
+
+    double *v_prev = (double*)malloc(n * sizeof(double));
+    double *v = (double*)malloc(n * sizeof(double));
+    double *w = (double*)malloc(n * sizeof(double));
+    double *alpha = (double*)malloc(4 * steps * sizeof(double));
+    if (v_prev == NULL || v == NULL || w == NULL || alpha == NULL) {
+        printf("\n ERROR : not enough memory for the lanczos vectors\n\n");
+        free(v_prev); free(v); free(w); free(alpha);
+        return EXIT_FAILURE;
+    }
+    double *beta = alpha + steps; // the remaining space is used for the tridiagonal eigenvector
+    double *z = beta + steps, *c = z + steps;
+
+    /* pseudo random start vector, a constant one would be almost orthogonal
+       to the checkerboard-like eigenvector of the max eigenvalue */
+    unsigned int seed = 12345u;
+    double norm = 0;
+    for (int i = 0; i < n; i++) {
+        seed = 1103515245u * seed + 12345u;
+        v[i] = (double)(seed >> 8) / (1u << 24) - 0.5;
+        v_prev[i] = 0;
+        norm += square(v[i]);
+    }
+    norm = sqrt(norm);
+    for (int i = 0; i < n; i++) v[i] /= norm;
+
+    int k = 0;
+    double beta_prev = 0;
+    for (k = 0; k < steps; k++) {
+        if (s->b != NULL) matvec_generalized(v, w, &blockSize, NULL);
+        else matvec_primme(v, w, &blockSize, NULL);
+        double a = 0;
+        for (int i = 0; i < n; i++) {
+            w[i] -= beta_prev * v_prev[i];
+            a += w[i] * v[i];
+        }
+        double b = 0;
+        for (int i = 0; i < n; i++) {
+            w[i] -= a * v[i];
+            b += square(w[i]);
+        }
+        alpha[k] = a;
+        beta[k] = b = sqrt(b);
+        if (b <= 1e-14 * fabs(a)) { k++; break; } // invariant subspace found : ritz values are exact
+        for (int i = 0; i < n; i++) {
+            v_prev[i] = v[i];
+            v[i] = w[i] / b;
+        }
+        beta_prev = b;
+    }
+
+    res->gershgorin = gershgorin_max(s);
+    res->ritz = tridiag_max(alpha, beta, k);
+    res->residual = fabs(beta[k-1] * tridiag_last_component(alpha, beta, k, res->ritz, z, c));
+    res->bound = safety * (res->ritz + res->residual);
+    if (res->bound > res->gershgorin) res->bound = res->gershgorin;
+    res->gap = (res->bound - res->ritz) / res->ritz;
+
+    free(v_prev); free(v); free(w); free(alpha);
+    return EXIT_SUCCESS;
+}
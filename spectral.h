@@ -0,0 +1,18 @@
+#ifndef SPECTRAL_H
+#define SPECTRAL_H
+
+#include "prob.h"
+
+typedef struct {
+    double gershgorin; // upper bound from the rows of the CSR matrix
+    double ritz; // largest ritz value of the lanczos steps, always a lower bound of the max eigenvalue
+    double residual; // |beta_k * s_k|, residual of the largest ritz pair
+    double bound; // upper bound for the max eigenvalue that should be used
+    double gap; // (bound - ritz)/ritz, tells how tight the bound is
+} spectral_bound;
+
+double gershgorin_max(problem *s);
+
+int lanczos_bound(problem *s, int steps, double safety, spectral_bound *res);
+
+#endif // !SPECTRAL_H
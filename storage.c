@@ -0,0 +1,92 @@
+#include "storage.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include "config.h"
+#if LARGE_GRID
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define STORAGE_MAX_MAPS 16 // ia, ja, a, b of two problems (richardson) and the eigenvectors
+
+#if LARGE_GRID
+typedef struct {
+    void *ptr;
+    size_t bytes;
+} storage_map;
+
+static storage_map maps[STORAGE_MAX_MAPS];
+#endif
+
+/// @brief allocates an array of the matrix or an eigenvector : malloc, or with LARGE_GRID a shared
+/// mapping of a file in LARGE_GRID_DIR so that the pages can be written back to disk instead of swapped
+/// @param bytes size of the array
+/// @param name used in the name of the backing file
+/// @return the array, NULL if it could not be allocated
+/// @note the file is unlinked as soon as it is mapped, the disk space is released by storage_free()
+/// or at the end of the process
+void *storage_alloc(size_t bytes, const char *name) {
+    #if LARGE_GRID
+    int slot = 0;
+    while (slot < STORAGE_MAX_MAPS && maps[slot].ptr != NULL) slot++;
+    if (slot == STORAGE_MAX_MAPS) {
+        printf("\n ERROR : more than %d file-backed arrays\n\n", STORAGE_MAX_MAPS);
+        return NULL;
+    }
+    if (bytes == 0) bytes = 1;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/membrane_%s_XXXXXX", LARGE_GRID_DIR, name);
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        printf("\n ERROR : cannot create the backing file %s\n\n", path);
+        return NULL;
+    }
+    unlink(path);
+    /* the blocks are reserved now, a full disk would otherwise be a SIGBUS when the array is written */
+    if (posix_fallocate(fd, 0, bytes)) {
+        printf("\n ERROR : not enough space in %s for %s (%zu bytes)\n\n", LARGE_GRID_DIR, name, bytes);
+        close(fd);
+        return NULL;
+    }
+    void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        printf("\n ERROR : cannot map the backing file of %s\n\n", name);
+        return NULL;
+    }
+    madvise(ptr, bytes, MADV_SEQUENTIAL);
+    maps[slot].ptr = ptr;
+    maps[slot].bytes = bytes;
+    return ptr;
+    #else
+    return malloc(bytes);
+    #endif
+}
+
+/// @brief frees an array given by storage_alloc() (or by malloc), NULL is ignored
+void storage_free(void *ptr) {
+    if (ptr == NULL) return;
+    #if LARGE_GRID
+    for (int k = 0; k < STORAGE_MAX_MAPS; k++) {
+        if (maps[k].ptr != ptr) continue;
+        munmap(ptr, maps[k].bytes);
+        maps[k].ptr = NULL;
+        return;
+    }
+    #endif
+    free(ptr);
+}
+
+/// @brief asks the kernel to start reading a part of a file-backed array (read-ahead), nothing without LARGE_GRID
+/// @param ptr first byte that will be read
+/// @param bytes number of bytes that will be read
+void storage_prefetch(const void *ptr, size_t bytes) {
+    #if LARGE_GRID
+    if (bytes == 0) return;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (size_t)ptr & ~(page - 1);
+    madvise((void*)start, (size_t)ptr + bytes - start, MADV_WILLNEED);
+    #endif
+}
@@ -0,0 +1,12 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stddef.h>
+
+void *storage_alloc(size_t bytes, const char *name);
+
+void storage_free(void *ptr);
+
+void storage_prefetch(const void *ptr, size_t bytes);
+
+#endif // !STORAGE_H
@@ -1,7 +1,14 @@
 #include "temperature.h"
 #include "gnuplot.h"
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include "config.h"
+#include "cholesky.h"
+#include "fastpoisson.h"
+#include "kernels.h"
+#define square(x) (x)*(x)
 double d = DIFFUSIVITY;
 
 /// @brief iterates through u(k+1) = (I-DA)u(k) = u(k) -Dv(k)
@@ -12,9 +19,287 @@ double d = DIFFUSIVITY;
 /// @param n size of both uk and vk vector
 /// @param dt time step of the progressive euler method
 /// @param t time elapsed since starting the method 
-void temperature_iterate(double *uk, double *vk, int n, double dt, double *t) {
+/// @return rms of du/dt = -D*vk, the update norm of the step divided by dt
+double temperature_iterate(double *uk, double *vk, int n, double dt, double *t) {
+    double rate = 0;
+    #if KERNEL_LIBRARY
+    rate = kernel_euler(uk, vk, n, dt*d);
+    #else
     for (int i = 0; i < n; i++) {
         uk[i] -= dt*d*vk[i];
+        rate += square(vk[i]);
     }
+    #endif
     (*t)+=dt;
+    return d*sqrt(rate/n);
+}
+
+/// @brief one step of the backward euler method (I + dt*D*A) u(k+1) = u(k), without any stability limit on dt.
+///        The factorization of I + dt*D*A is cached, only the first step with a given dt factors it
+///        (with FAST_POISSON_SOLVER the fast poisson solver is cached the same way).
+///        With the 9 point stencil the step is (B + dt*D*A) u(k+1) = B u(k).
+/// @param s the problem object holding the matrix A
+/// @param uk temperature at any point of the grid, replaced by u(k+1)
+/// @param vk work vector of the same size
+/// @param dt time step
+/// @param t time elapsed since starting the method
+/// @return rms of (u(k+1)-u(k))/dt, negative if the factorization failed
+double temperature_implicit(problem *s, double *uk, double *vk, double dt, double *t) {
+    #if STENCIL_9PT
+    /* (B + dt*D*A) u(k+1) = B u(k) : B + dt*D*A = dt*D * (A + B/(dt*D)) is factored from the values
+       of A + B/(dt*D) kept in the problem, they follow dt like the key of the cached factor */
+    csr_off nnz = s->ia[s->n];
+    if (s->shifted == NULL) {
+        s->shifted = (double*)malloc(nnz * sizeof(double));
+        if (s->shifted == NULL) return -1;
+        s->shifted_dt = 0;
+    }
+    if (s->shifted_dt != dt*d) {
+        for (csr_off j = 0; j < nnz; j++) s->shifted[j] = s->a[j] + s->b[j] / (dt*d);
+        s->shifted_dt = dt*d;
+    }
+    cholesky *f = cholesky_get(s, s->shifted, 0.0, dt*d);
+    if (f == NULL) return -1;
+    memcpy(vk, uk, s->n * sizeof(double));
+    for (int i = 0; i < s->n; i++) {
+        uk[i] = 0;
+        for (csr_off j = s->ia[i]; j < s->ia[i+1]; j++) uk[i] += s->b[j] * vk[s->ja[j]];
+    }
+    if (f->solve(f, uk, uk)) return -1;
+    #else
+    #if FAST_POISSON_SOLVER
+    fastpoisson *f = fastpoisson_get(s, 1.0, dt*d);
+    #else
+    cholesky *f = cholesky_get(s, s->a, 1.0, dt*d);
+    #endif
+    if (f == NULL) return -1;
+    memcpy(vk, uk, s->n * sizeof(double));
+    if (f->solve(f, vk, uk)) return -1;
+    #endif
+    double rate = 0;
+    for (int i = 0; i < s->n; i++) rate += square(uk[i] - vk[i]);
+    (*t) += dt;
+    return sqrt(rate / s->n) / dt;
+}
+
+/// @brief f = F(y) = -D*A*y, the right hand side of the heat equation
+static void rkc_rhs(rkc *s, double *y, double *f) {
+    int blockSize = 1;
+    s->matvec(y, f, &blockSize, NULL);
+    for (int i = 0; i < s->n; i++) f[i] *= -d;
+    s->matvecs++;
+}
+
+/// @brief One step of the second order Runge-Kutta-Chebyshev method (Sommeijer, Shampine, Verwer 1997).
+/// With s stages the stability interval is about [-0.65 s^2, 0], s is chosen from h*spcrad.
+/// @param y0 solution at the beginning of the step, f0 = F(y0) has to be in s->f0
+/// @param h step size
+/// @param y pointer to the solution at the end of the step (one of the work vectors),
+///          F(y) is left in s->f1 for the next step
+/// @return the weighted rms norm of the embedded error estimate, the step is accepted if <= 1
+static double rkc_step(rkc *s, double *y0, double h, double **y) {
+    int n = s->n;
+    double *f0 = s->f0, *fj = s->f1;
+    double *yjm2 = s->work, *yjm1 = s->work + n, *yj = s->work + 2*n;
+
+    int stages = 1 + (int)sqrt(1.0 + 1.54 * h * s->spcrad);
+    if (stages < 2) stages = 2;
+    if (stages > s->max_stages) s->max_stages = stages;
+
+    /* chebyshev polynomial T_s and its derivatives at w0 give w1 */
+    double w0 = 1.0 + 2.0 / (13.0 * stages * stages);
+    double tm = 1, tc = w0, dtm = 0, dtc = 1, ddtm = 0, ddtc = 0;
+    for (int j = 2; j <= stages; j++) {
+        double tn = 2*w0*tc - tm, dtn = 2*tc + 2*w0*dtc - dtm, ddtn = 4*dtc + 2*w0*ddtc - ddtm;
+        tm = tc; tc = tn; dtm = dtc; dtc = dtn; ddtm = ddtc; ddtc = ddtn;
+    }
+    double w1 = dtc / ddtc;
+
+    /* b_j = T_j''(w0)/T_j'(w0)^2 for j >= 2 and b_0 = b_1 = b_2 */
+    double bjm2 = 4.0 / (16.0*w0*w0), bjm1 = bjm2;
+
+    /* first stage */
+    double mut1 = bjm1 * w1;
+    for (int i = 0; i < n; i++) {
+        yjm2[i] = y0[i];
+        yjm1[i] = y0[i] + mut1 * h * f0[i];
+    }
+
+    /* remaining stages, T_j is rebuilt along the way */
+    tm = 1; tc = w0; dtm = 0; dtc = 1; ddtm = 0; ddtc = 0;
+    for (int j = 2; j <= stages; j++) {
+        double tn = 2*w0*tc - tm, dtn = 2*tc + 2*w0*dtc - dtm, ddtn = 4*dtc + 2*w0*ddtc - ddtm;
+        double bj = ddtn / (dtn*dtn);
+
+        double mu = 2.0 * w0 * bj / bjm1;
+        double nu = -bj / bjm2;
+        double mut = 2.0 * w1 * bj / bjm1;
+        double gamt = -(1.0 - bjm1 * tc) * mut;
+
+        rkc_rhs(s, yjm1, fj);
+        for (int i = 0; i < n; i++) {
+            yj[i] = (1.0 - mu - nu) * y0[i] + mu * yjm1[i] + nu * yjm2[i] + h * (mut * fj[i] + gamt * f0[i]);
+        }
+
+        double *tmp = yjm2; yjm2 = yjm1; yjm1 = yj; yj = tmp;
+        tm = tc; tc = tn; dtm = dtc; dtc = dtn; ddtm = ddtc; ddtc = ddtn;
+        bjm2 = bjm1; bjm1 = bj;
+    }
+    *y = yjm1; // last stage after the rotation
+
+    /* embedded error estimate (12(y0-y) + 6h(f0+F(y)))/15 */
+    rkc_rhs(s, *y, fj);
+    double err = 0;
+    for (int i = 0; i < n; i++) {
+        double est = (12.0 * (y0[i] - (*y)[i]) + 6.0 * h * (f0[i] + fj[i])) / 15.0;
+        double w = s->tol * (1.0 + fmax(fabs(y0[i]), fabs((*y)[i])));
+        err += square(est / w);
+    }
+    return sqrt(err / n);
+}
+
+/// @brief Advances the temperature from t to t_end with adaptive RKC steps
+/// @param s the rkc object
+/// @param uk temperature at any point of the grid, overwritten by the temperature at t_end
+/// @param t time elapsed since starting the method, equal to t_end at the end
+/// @param t_end time to reach, the last step is shortened to land on it
+/// @return integer for error handling
+int rkc_advance(rkc *s, double *uk, double *t, double t_end) {
+    double *y;
+    rkc_rhs(s, uk, s->f0);
+
+    while (*t < t_end) {
+        double h = s->dt;
+        bool last = false;
+        if (*t + h >= t_end) {
+            h = t_end - *t;
+            last = true;
+        }
+
+        double err = rkc_step(s, uk, h, &y);
+
+        /* error per unit step control, the method is second order */
+        double fac = (err > 0) ? 0.8 * pow(err, -1.0/3.0) : 10.0;
+        if (fac > 10.0) fac = 10.0;
+        if (fac < 0.1) fac = 0.1;
+
+        if (err > 1.0) {
+            s->rejected++;
+            s->dt = h * fac;
+            if (s->dt < 1e-12 * t_end) {
+                printf("\n ERROR : RKC step size underflow at t = %g s\n\n", *t);
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        memcpy(uk, y, s->n * sizeof(double));
+        double *tmp = s->f0; s->f0 = s->f1; s->f1 = tmp;
+        *t = last ? t_end : *t + h;
+        s->steps++;
+        // a shortened last step does not tell anything about the step we can afford
+        if (!last || h * fac > s->dt) s->dt = h * fac;
+    }
+    return EXIT_SUCCESS;
+}
+
+/// @brief frees the work vectors of the rkc object
+void close_rkc(rkc *s) {
+    free(s->work);
+}
+
+/// @brief Initializes the Runge-Kutta-Chebyshev integrator of du/dt = -D*A*u
+/// @param self the yet uninitialized object
+/// @param n number of unknowns
+/// @param spcrad upper bound of the spectral radius of D*A (max eigenvalue times the diffusivity)
+/// @param tol tolerance of the embedded error estimate, replaces the fixed dt of the euler method
+/// @param dt first step size tried
+/// @param matvec the A*x product, matvec_primme in this program
+/// @return integer for error handling
+int init_rkc(rkc *self, int n, double spcrad, double tol, double dt, matvec_t matvec) {
+    self->n = n;
+    self->spcrad = spcrad;
+    self->tol = tol;
+    self->dt = dt;
+    self->matvec = matvec;
+    self->matvecs = self->steps = self->rejected = self->max_stages = 0;
+
+    self->work = (double*)malloc(5 * n * sizeof(double));
+    if (self->work == NULL) {
+        printf("\n ERROR : not enough memory for the RKC work vectors\n\n");
+        return EXIT_FAILURE;
+    }
+    self->f0 = self->work + 3*n;
+    self->f1 = self->work + 4*n;
+
+    self->advance = rkc_advance;
+    self->close = close_rkc;
+    return EXIT_SUCCESS;
+}
+
+/// @brief gives the rate of change of the field to the monitor
+/// @param dudt du/dt, or any vector proportional to it (A*uk for the euler method)
+/// @param scale factor to get du/dt from the given vector, NULL dudt means scale is already the rms of du/dt
+void monitor_update(heat_monitor *s, double *dudt, double scale) {
+    if (dudt == NULL) {
+        s->rate = scale;
+        return;
+    }
+    double rate = 0;
+    for (int i = 0; i < s->n; i++) rate += square(dudt[i]);
+    s->rate = fabs(scale) * sqrt(rate / s->n);
+}
+
+/// @return true if the rms of du/dt went below the steady state tolerance
+int monitor_steady(heat_monitor *s) {
+    return s->rate < s->steady_tol;
+}
+
+/// @brief decides if a frame is emitted : when the field changed enough since the last emitted frame, or when
+///        it is forced (steady state, last iteration). An emitted frame is counted and becomes the new reference
+/// @param uk current temperature field
+/// @param force emits the frame even if the field did not change enough
+/// @return true if a frame should be emitted
+int monitor_emit(heat_monitor *s, double *uk, int force) {
+    double change = 0;
+    for (int i = 0; i < s->n && !force; i++) change = fmax(change, fabs(uk[i] - s->last_frame[i]));
+    if (!force && change <= s->frame_tol) {
+        s->skipped++;
+        return false;
+    }
+    memcpy(s->last_frame, uk, s->n * sizeof(double));
+    s->frames++;
+    return true;
+}
+
+/// @brief frees the reference frame of the monitor
+void close_heat_monitor(heat_monitor *s) {
+    free(s->last_frame);
+}
+
+/// @brief Initializes the monitor deciding when the heat loop stops and which frames are displayed
+/// @param self the yet uninitialized object
+/// @param n number of unknowns
+/// @param steady_tol rms of du/dt (temperature per second) under which the loop can stop
+/// @param frame_tol max change of temperature since the last emitted frame to emit a new one
+/// @param u0 initial field, taken as the first reference frame
+/// @return integer for error handling
+int init_heat_monitor(heat_monitor *self, int n, double steady_tol, double frame_tol, double *u0) {
+    self->n = n;
+    self->steady_tol = steady_tol;
+    self->frame_tol = frame_tol;
+    self->rate = INFINITY;
+    self->frames = self->skipped = 0;
+    self->last_frame = (double*)malloc(n * sizeof(double));
+    if (self->last_frame == NULL) {
+        printf("\n ERROR : not enough memory for the heat monitor\n\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(self->last_frame, u0, n * sizeof(double));
+
+    self->update = monitor_update;
+    self->steady = monitor_steady;
+    self->emit = monitor_emit;
+    self->close = close_heat_monitor;
+    return EXIT_SUCCESS;
 }
@@ -2,6 +2,44 @@
 
 #define TEMPERATURE_H
 
-void temperature_iterate(double *uk, double *vk, int n, double dt, double *t);
+#include "interface_primme.h"
+
+double temperature_iterate(double *uk, double *vk, int n, double dt, double *t);
+
+double temperature_implicit(problem *s, double *uk, double *vk, double dt, double *t);
+
+typedef void (*matvec_t)(void*, void*, int*, primme_params*);
+
+typedef struct sRkc rkc;
+struct sRkc {
+    int n;
+    double spcrad; // spectral radius of D*A, the stable step grows like s^2/spcrad
+    double tol; // tolerance on the embedded error estimate
+    double dt; // step size proposed for the next step
+    int matvecs, steps, rejected, max_stages;
+    double *work; // holds the stage vectors
+    double *f0, *f1; // right hand side at the beginning and at the end of a step
+    matvec_t matvec;
+    int (*advance)(rkc*, double*, double*, double);
+    void (*close)(rkc*);
+};
+
+int init_rkc(rkc *self, int n, double spcrad, double tol, double dt, matvec_t matvec);
+
+typedef struct sHeatMonitor heat_monitor;
+struct sHeatMonitor {
+    int n;
+    double steady_tol; // rms of du/dt under which the field is considered steady
+    double frame_tol; // max change of temperature since the last frame needed to emit a new one
+    double rate; // last known rms of du/dt
+    double *last_frame; // field of the last emitted frame
+    int frames, skipped;
+    void (*update)(heat_monitor*, double*, double);
+    int (*steady)(heat_monitor*);
+    int (*emit)(heat_monitor*, double*, int);
+    void (*close)(heat_monitor*);
+};
+
+int init_heat_monitor(heat_monitor *self, int n, double steady_tol, double frame_tol, double *u0);
 
 #endif // !TEMPERATURE_H